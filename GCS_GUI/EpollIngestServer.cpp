@@ -0,0 +1,432 @@
+#include "EpollIngestServer.h"
+#include "BinaryLog.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const quint32 CONNECTION_EVENTS = EPOLLIN | EPOLLRDHUP | EPOLLET;
+
+// Dual-stack listeners report IPv4 peers as ::ffff:a.b.c.d; use the plain
+// form so tracks and partial images are keyed as with MyTCPServer's peers.
+QString peerAddress(const sockaddr_storage& address, quint16& port)
+{
+    QHostAddress host(reinterpret_cast<const sockaddr*>(&address));
+    port = address.ss_family == AF_INET6
+        ? ntohs(reinterpret_cast<const sockaddr_in6*>(&address)->sin6_port)
+        : ntohs(reinterpret_cast<const sockaddr_in*>(&address)->sin_port);
+    bool isIPv4 = false;
+    quint32 ipv4 = host.toIPv4Address(&isIPv4);
+    return isIPv4 ? QHostAddress(ipv4).toString() : host.toString();
+}
+
+}
+
+EpollIngestServer::EpollIngestServer(int port, QObject *parent)
+    : IngestServer(parent)
+{
+    _isStarted = listen(port);
+    if (!_isStarted) {
+        qDebug() << "Server could not start";
+        return;
+    }
+    qDebug() << "Server started (epoll)...";
+    _ioThread = std::thread(&EpollIngestServer::run, this);
+}
+
+EpollIngestServer::~EpollIngestServer()
+{
+    if (_ioThread.joinable()) {
+        _stopping = true;
+        wake();
+        _ioThread.join();
+    }
+    for (auto& entry : _ioConnections) {
+        ::close(entry.second->fd);
+        MetricsRegistry::instance().removeConnection(entry.second->metrics);
+    }
+    for (int fd : {_listenFd, _epollFd, _wakeFd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool EpollIngestServer::isStarted() const
+{
+    return _isStarted;
+}
+
+quint16 EpollIngestServer::port() const
+{
+    return _port;
+}
+
+bool EpollIngestServer::listen(int port)
+{
+    // Prefer a dual-stack socket, like QHostAddress::Any; fall back to IPv4
+    // on hosts without IPv6.
+    _listenFd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    int zero = 0;
+    if (_listenFd >= 0) {
+        ::setsockopt(_listenFd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        ::setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in6 address = {};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr = in6addr_any;
+        address.sin6_port = htons(quint16(port));
+        if (::bind(_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ::close(_listenFd);
+            _listenFd = -1;
+        }
+    }
+    if (_listenFd < 0) {
+        _listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (_listenFd < 0) {
+            return false;
+        }
+        ::setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(quint16(port));
+        if (::bind(_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            return false;
+        }
+    }
+    if (::listen(_listenFd, SOMAXCONN) < 0) {
+        return false;
+    }
+
+    sockaddr_storage bound = {};
+    socklen_t length = sizeof(bound);
+    ::getsockname(_listenFd, reinterpret_cast<sockaddr*>(&bound), &length);
+    peerAddress(bound, _port);
+
+    _epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    _wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epollFd < 0 || _wakeFd < 0) {
+        return false;
+    }
+    // The listener and the wake fd are level-triggered: both are drained
+    // completely, and a full fd table must not lose pending accepts.
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_KEY;
+    ::epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenFd, &event);
+    event.data.u64 = WAKE_KEY;
+    ::epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeFd, &event);
+    return true;
+}
+
+void EpollIngestServer::wake()
+{
+    quint64 one = 1;
+    ssize_t written = ::write(_wakeFd, &one, sizeof(one));
+    Q_UNUSED(written);
+}
+
+void EpollIngestServer::run()
+{
+    epoll_event events[MAX_EVENTS];
+    while (!_stopping) {
+        // Connections that hit the per-wakeup read limit still have data
+        // that no new edge will announce, so poll instead of blocking.
+        int count = ::epoll_wait(_epollFd, events, MAX_EVENTS, _readable.empty() ? -1 : 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qDebug() << "epoll_wait failed:" << errno;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            quint64 key = events[i].data.u64;
+            if (key == LISTENER_KEY) {
+                acceptConnections();
+                continue;
+            }
+            if (key == WAKE_KEY) {
+                quint64 value;
+                ssize_t bytes = ::read(_wakeFd, &value, sizeof(value));
+                Q_UNUSED(bytes);
+                flushOutbox();
+                continue;
+            }
+            auto it = _ioConnections.find(key);
+            if (it == _ioConnections.end()) {
+                continue;
+            }
+            Connection* connection = it->second.get();
+            if (events[i].events & EPOLLERR) {
+                closeConnection(connection);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!flushConnection(connection)) {
+                    continue;
+                }
+            }
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !connection->readable) {
+                connection->readable = true;
+                _readable.push_back(connection);
+            }
+        }
+
+        std::vector<Connection*> ready;
+        ready.swap(_readable);
+        for (Connection* connection : ready) {
+            connection->readable = false;
+            readConnection(connection);
+        }
+        postEvents();
+    }
+}
+
+void EpollIngestServer::acceptConnections()
+{
+    for (;;) {
+        sockaddr_storage address = {};
+        socklen_t length = sizeof(address);
+        int fd = ::accept4(_listenFd, reinterpret_cast<sockaddr*>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                // Stop polling the listener until a connection closes, or
+                // the level-triggered event would spin.
+                qDebug() << "Out of file descriptors, pausing accept";
+                epoll_event event = {};
+                event.data.u64 = LISTENER_KEY;
+                ::epoll_ctl(_epollFd, EPOLL_CTL_MOD, _listenFd, &event);
+                _acceptPaused = true;
+            }
+            return;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->id = _nextConnectionId++;
+        connection->fd = fd;
+        connection->decoder.reserve(BUFFER_SIZE);
+        quint16 port = 0;
+        QString peer = peerAddress(address, port);
+        connection->metrics = MetricsRegistry::instance().addConnection(QString("%1:%2").arg(peer).arg(port));
+
+        epoll_event event = {};
+        event.events = CONNECTION_EVENTS;
+        event.data.u64 = connection->id;
+        if (::epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            MetricsRegistry::instance().removeConnection(connection->metrics);
+            ::close(fd);
+            continue;
+        }
+
+        IoEvent connected;
+        connected.kind = IoEvent::Connected;
+        connected.id = connection->id;
+        connected.peerAddress = peer;
+        connected.peerPort = port;
+        connected.metrics = connection->metrics;
+        _events.append(connected);
+        _ioConnections.emplace(connection->id, std::move(connection));
+    }
+}
+
+void EpollIngestServer::readConnection(Connection* connection)
+{
+    FrameDecoder& decoder = connection->decoder;
+    ConnectionMetrics& metrics = *connection->metrics;
+    quint64 droppedBefore = decoder.droppedFrames();
+    Timing& parseTiming = MetricsRegistry::instance().stage(Stage::TelemetryParse).duration;
+    qsizetype total = 0;
+    bool closed = false;
+
+    for (;;) {
+        if (total >= MAX_READ_PER_WAKEUP) {
+            connection->readable = true;
+            _readable.push_back(connection);
+            break;
+        }
+        char* buffer = decoder.prepareAppend(READ_SIZE);
+        ssize_t received = ::recv(connection->fd, buffer, READ_SIZE, 0);
+        if (received <= 0) {
+            decoder.commitAppend(0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            closed = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        decoder.commitAppend(received);
+        total += received;
+        BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::GcsBufferReceived, quint64(received), quint64(connection->fd),
+                     BinaryLog::prefix(QByteArray::fromRawData(buffer, received)));
+
+        // Decode after every read so the buffer stays at its preallocated size.
+        IoEvent event;
+        QElapsedTimer timer;
+        timer.start();
+        while (decoder.next(event.frame)) {
+            if (event.frame.type == DecodedFrame::Telemetry || event.frame.type == DecodedFrame::TelemetryBatch) {
+                parseTiming.record(timer.nsecsElapsed());
+            }
+            metrics.framesIn.add();
+            event.id = connection->id;
+            _events.append(event);
+            timer.restart();
+        }
+    }
+
+    metrics.bytesIn.add(total);
+    metrics.bufferedBytes.set(decoder.buffered());
+    metrics.drops.add(decoder.droppedFrames() - droppedBefore);
+    if (closed) {
+        closeConnection(connection);
+    }
+}
+
+void EpollIngestServer::flushOutbox()
+{
+    std::vector<OutgoingFrame> outbox;
+    {
+        std::lock_guard<std::mutex> lock(_outboxMutex);
+        outbox.swap(_outbox);
+    }
+    for (OutgoingFrame& frame : outbox) {
+        auto it = _ioConnections.find(frame.id);
+        if (it == _ioConnections.end()) {
+            continue;
+        }
+        Connection* connection = it->second.get();
+        // A vehicle that stops reading loses acks and feedback rather than
+        // growing our memory.
+        if (connection->output.size() - connection->outputPos + frame.data.size() > MAX_OUTPUT) {
+            connection->metrics->drops.add();
+            continue;
+        }
+        connection->output.append(frame.data);
+        if (!connection->wantWrite) {
+            flushConnection(connection);
+        }
+    }
+}
+
+bool EpollIngestServer::flushConnection(Connection* connection)
+{
+    while (connection->outputPos < connection->output.size()) {
+        ssize_t sent = ::send(connection->fd, connection->output.constData() + connection->outputPos,
+                              connection->output.size() - connection->outputPos, MSG_NOSIGNAL);
+        if (sent >= 0) {
+            connection->outputPos += sent;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            setWantWrite(connection, true);
+            return true;
+        } else {
+            closeConnection(connection);
+            return false;
+        }
+    }
+    connection->output.resize(0);
+    connection->outputPos = 0;
+    setWantWrite(connection, false);
+    return true;
+}
+
+void EpollIngestServer::setWantWrite(Connection* connection, bool wantWrite)
+{
+    if (connection->wantWrite == wantWrite) {
+        return;
+    }
+    connection->wantWrite = wantWrite;
+    epoll_event event = {};
+    event.events = CONNECTION_EVENTS | (wantWrite ? EPOLLOUT : 0);
+    event.data.u64 = connection->id;
+    ::epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+}
+
+void EpollIngestServer::closeConnection(Connection* connection)
+{
+    ::epoll_ctl(_epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    if (connection->readable) {
+        _readable.erase(std::remove(_readable.begin(), _readable.end(), connection), _readable.end());
+    }
+    if (_acceptPaused) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = LISTENER_KEY;
+        ::epoll_ctl(_epollFd, EPOLL_CTL_MOD, _listenFd, &event);
+        _acceptPaused = false;
+    }
+    // Removed here as well as in removeConnection(), in case the server goes
+    // away before the event is delivered.
+    MetricsRegistry::instance().removeConnection(connection->metrics);
+
+    IoEvent disconnected;
+    disconnected.kind = IoEvent::Disconnected;
+    disconnected.id = connection->id;
+    _events.append(disconnected);
+    _ioConnections.erase(connection->id);
+}
+
+void EpollIngestServer::postEvents()
+{
+    if (_events.isEmpty()) {
+        return;
+    }
+    QVector<IoEvent> events;
+    events.swap(_events);
+    QMetaObject::invokeMethod(this, [this, events]() mutable {
+        deliverEvents(events);
+    }, Qt::QueuedConnection);
+}
+
+void EpollIngestServer::deliverEvents(QVector<IoEvent>& events)
+{
+    for (IoEvent& event : events) {
+        switch (event.kind) {
+        case IoEvent::Connected:
+            qDebug() << "A client connected to server";
+            addConnection(event.id, event.peerAddress, event.peerPort, event.metrics);
+            break;
+        case IoEvent::Frame:
+            handleFrame(event.id, event.frame);
+            break;
+        case IoEvent::Disconnected:
+            removeConnection(event.id);
+            break;
+        }
+    }
+}
+
+qint64 EpollIngestServer::writeFrame(quint64 id, const QByteArray& frame)
+{
+    if (!_isStarted) {
+        return -1;
+    }
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(_outboxMutex);
+        wasEmpty = _outbox.empty();
+        _outbox.push_back({id, frame});
+    }
+    if (wasEmpty) {
+        wake();
+    }
+    return frame.size();
+}
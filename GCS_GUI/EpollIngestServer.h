@@ -0,0 +1,102 @@
+#ifndef EPOLLINGESTSERVER_H
+#define EPOLLINGESTSERVER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "IngestServer.h"
+#include "FrameDecoder.h"
+
+// Linux transport for large fleets. One I/O thread owns a non-blocking
+// listener and every connection in a single epoll set; connections are
+// edge-triggered and read straight into their FrameDecoder's preallocated
+// buffer until EAGAIN. Decoded frames from one wakeup are handed to this
+// object's thread in a single queued call, so the per-frame signals are the
+// same as MyTCPServer's but the cross-thread cost is per batch.
+// Outgoing frames are queued by writeFrame() and sent by the I/O thread.
+class EpollIngestServer : public IngestServer
+{
+    Q_OBJECT
+
+public:
+    explicit EpollIngestServer(int port, QObject *parent = nullptr);
+    ~EpollIngestServer();
+    bool isStarted() const override;
+    quint16 port() const override;
+
+protected:
+    qint64 writeFrame(quint64 id, const QByteArray& frame) override;
+
+private:
+    struct Connection {
+        quint64 id = 0;
+        int fd = -1;
+        FrameDecoder decoder;
+        std::shared_ptr<ConnectionMetrics> metrics;
+        QByteArray output;
+        qsizetype outputPos = 0;
+        bool wantWrite = false;     // EPOLLOUT armed
+        bool readable = false;      // on _readable, data may be left unread
+    };
+
+    // What the I/O thread reports, in the order it happened.
+    struct IoEvent {
+        enum Kind { Connected, Frame, Disconnected };
+        Kind kind = Frame;
+        quint64 id = 0;
+        QString peerAddress;
+        quint16 peerPort = 0;
+        std::shared_ptr<ConnectionMetrics> metrics;
+        DecodedFrame frame;
+    };
+
+    struct OutgoingFrame {
+        quint64 id;
+        QByteArray data;
+    };
+
+    int _listenFd = -1;
+    int _epollFd = -1;
+    int _wakeFd = -1;
+    quint16 _port = 0;
+    bool _isStarted = false;
+    bool _acceptPaused = false;     // I/O thread: out of file descriptors
+    std::atomic<bool> _stopping{false};
+    std::thread _ioThread;
+
+    std::mutex _outboxMutex;
+    std::vector<OutgoingFrame> _outbox;
+
+    // Owned by the I/O thread.
+    std::unordered_map<quint64, std::unique_ptr<Connection>> _ioConnections;
+    std::vector<Connection*> _readable;
+    QVector<IoEvent> _events;
+    quint64 _nextConnectionId = 1;
+
+    bool listen(int port);
+    void wake();
+    void run();
+    void acceptConnections();
+    void readConnection(Connection* connection);
+    void flushOutbox();
+    bool flushConnection(Connection* connection); // false if it closed the connection
+    void setWantWrite(Connection* connection, bool wantWrite);
+    void closeConnection(Connection* connection);
+    void postEvents();
+    void deliverEvents(QVector<IoEvent>& events);
+
+    static constexpr quint64 LISTENER_KEY = ~quint64(0);
+    static constexpr quint64 WAKE_KEY = ~quint64(0) - 1;
+    static constexpr int MAX_EVENTS = 256;
+    static constexpr qsizetype BUFFER_SIZE = 16 * 1024;          // preallocated per connection
+    static constexpr qsizetype READ_SIZE = 16 * 1024;
+    static constexpr qsizetype MAX_READ_PER_WAKEUP = 256 * 1024; // per connection, for fairness
+    static constexpr qsizetype MAX_OUTPUT = 1024 * 1024;         // queued bytes per connection
+};
+
+#endif // EPOLLINGESTSERVER_H
@@ -0,0 +1,220 @@
+#include "FrameDecoder.h"
+
+#include <cstring>
+
+namespace {
+
+const char TELEMETRY_PREFIX[] = "Latitude:";
+const qsizetype TELEMETRY_PREFIX_SIZE = sizeof(TELEMETRY_PREFIX) - 1;
+const qsizetype MAX_TELEMETRY_LINE = 1024;
+
+const quint32 BINARY_HEADERS[] = {
+    Protocol::IMAGE_HEADER,
+    Protocol::TEXT_HEADER,
+    Protocol::TELEMETRY_BATCH_HEADER,
+    Protocol::IMAGE_CHUNK_HEADER,
+    Protocol::CODED_IMAGE_CHUNK_HEADER,
+};
+
+// True if the bytes at p are, or could still become, the start of a frame.
+bool mayStartFrame(const char* p, qsizetype avail)
+{
+    if (std::memcmp(p, TELEMETRY_PREFIX, qMin(avail, TELEMETRY_PREFIX_SIZE)) == 0) {
+        return true;
+    }
+    for (quint32 header : BINARY_HEADERS) {
+        char bytes[4];
+        qToBigEndian(header, bytes);
+        if (std::memcmp(p, bytes, qMin<qsizetype>(avail, 4)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+void FrameDecoder::append(const char* data, qsizetype size)
+{
+    _buffer.append(data, size);
+}
+
+char* FrameDecoder::prepareAppend(qsizetype size)
+{
+    compact();
+    _appendPos = _buffer.size();
+    _buffer.resize(_appendPos + size);
+    return _buffer.data() + _appendPos;
+}
+
+void FrameDecoder::commitAppend(qsizetype n)
+{
+    // Shrinking keeps the capacity, so steady-state reads do not allocate.
+    _buffer.resize(_appendPos + n);
+}
+
+bool FrameDecoder::next(DecodedFrame& frame)
+{
+    for (;;) {
+        qsizetype avail = _buffer.size() - _pos;
+        if (avail <= 0) {
+            compact();
+            return false;
+        }
+        const char* p = _buffer.constData() + _pos;
+
+        if (!mayStartFrame(p, avail)) {
+            resync();
+            continue;
+        }
+
+        if (*p == TELEMETRY_PREFIX[0]) {
+            if (avail < TELEMETRY_PREFIX_SIZE) {
+                compact();
+                return false;
+            }
+            // Lines end at '\n'; older senders did not terminate them, so the
+            // start of the next line also ends one.
+            qsizetype end = _buffer.indexOf('\n', _pos);
+            qsizetype nextLine = _buffer.indexOf(TELEMETRY_PREFIX, _pos + TELEMETRY_PREFIX_SIZE);
+            if (end < 0 || (nextLine >= 0 && nextLine < end)) {
+                end = nextLine;
+            }
+            if (end < 0) {
+                if (avail > MAX_TELEMETRY_LINE) {
+                    resync();
+                    continue;
+                }
+                compact();
+                return false;
+            }
+
+            frame = DecodedFrame();
+            frame.type = DecodedFrame::Telemetry;
+            frame.text = QString::fromUtf8(p, end - _pos).trimmed();
+            _pos = _buffer[end] == '\n' ? end + 1 : end;
+
+            Protocol::TelemetrySample sample;
+            if (!Protocol::parseTelemetry(frame.text, sample)) {
+                ++_droppedFrames;
+                continue;
+            }
+            frame.samples.append(sample);
+            return true;
+        }
+
+        if (avail < 4) {
+            compact();
+            return false;
+        }
+        quint32 header = Protocol::readU32(p);
+
+        if (header == Protocol::IMAGE_HEADER || header == Protocol::TEXT_HEADER) {
+            if (avail < 8) {
+                compact();
+                return false;
+            }
+            qint32 size = qint32(Protocol::readU32(p + 4));
+            if (size <= 0 || size > Protocol::MAX_FRAME_PAYLOAD) {
+                ++_droppedFrames;
+                resync();
+                continue;
+            }
+            if (avail < 8 + size) {
+                compact();
+                return false;
+            }
+            frame = DecodedFrame();
+            if (header == Protocol::IMAGE_HEADER) {
+                frame.type = DecodedFrame::Image;
+                frame.payload = QByteArray(p + 8, size);
+            } else {
+                frame.type = DecodedFrame::Text;
+                frame.text = QString::fromUtf8(p + 8, size);
+            }
+            _pos += 8 + size;
+            return true;
+        }
+
+        if (header == Protocol::TELEMETRY_BATCH_HEADER) {
+            if (avail < 6) {
+                compact();
+                return false;
+            }
+            int count = qFromBigEndian<quint16>(p + 4);
+            qsizetype size = 6 + qsizetype(count) * Protocol::TELEMETRY_SAMPLE_SIZE;
+            if (avail < size) {
+                compact();
+                return false;
+            }
+            frame = DecodedFrame();
+            frame.type = DecodedFrame::TelemetryBatch;
+            frame.samples.resize(count);
+            const char* record = p + 6;
+            for (int i = 0; i < count; ++i, record += Protocol::TELEMETRY_SAMPLE_SIZE) {
+                Protocol::TelemetrySample& sample = frame.samples[i];
+                sample.timestamp = qFromBigEndian<qint64>(record);
+                sample.latitude = Protocol::readFloat(record + 8);
+                sample.longitude = Protocol::readFloat(record + 12);
+                sample.altitude = Protocol::readFloat(record + 16);
+            }
+            _pos += size;
+            return true;
+        }
+
+        // IMAGE_CHUNK_HEADER or CODED_IMAGE_CHUNK_HEADER, the only ones left
+        // that mayStartFrame accepts. Plain chunks predate codec negotiation
+        // and are always JPEG (codec 0).
+        bool coded = header == Protocol::CODED_IMAGE_CHUNK_HEADER;
+        const int fixedSize = coded ? Protocol::CODED_IMAGE_CHUNK_FIXED_SIZE : Protocol::IMAGE_CHUNK_FIXED_SIZE;
+        if (avail < fixedSize) {
+            compact();
+            return false;
+        }
+        const char* fields = p + (coded ? 12 : 8);
+        quint32 imageId = Protocol::readU32(p + 4);
+        quint8 codec = coded ? quint8(p[8]) : 0;
+        quint32 totalSize = Protocol::readU32(fields);
+        quint32 offset = Protocol::readU32(fields + 4);
+        qint32 size = qint32(Protocol::readU32(fields + 8));
+        if (size <= 0 || totalSize > quint32(Protocol::MAX_FRAME_PAYLOAD)
+            || offset > totalSize || quint32(size) > totalSize - offset) {
+            ++_droppedFrames;
+            resync();
+            continue;
+        }
+        if (avail < fixedSize + size) {
+            compact();
+            return false;
+        }
+        frame = DecodedFrame();
+        frame.type = DecodedFrame::ImageChunk;
+        frame.imageId = imageId;
+        frame.totalSize = totalSize;
+        frame.offset = offset;
+        frame.codec = codec;
+        frame.payload = QByteArray(p + fixedSize, size);
+        _pos += fixedSize + size;
+        return true;
+    }
+}
+
+void FrameDecoder::resync()
+{
+    qsizetype start = _pos;
+    const char* data = _buffer.constData();
+    qsizetype size = _buffer.size();
+    ++_pos;
+    while (_pos < size && !mayStartFrame(data + _pos, size - _pos)) {
+        ++_pos;
+    }
+    _droppedBytes += _pos - start;
+}
+
+void FrameDecoder::compact()
+{
+    if (_pos > 0) {
+        _buffer.remove(0, _pos);
+        _pos = 0;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "Protocol.h"
+
+struct DecodedFrame {
+    enum Type {
+        Telemetry,      // one sample in samples, the original line in text
+        TelemetryBatch, // samples
+        Text,           // text
+        Image,          // payload holds a whole encoded image
+        ImageChunk      // payload holds bytes [offset, offset + size) of imageId
+    };
+
+    Type type = Text;
+    QVector<Protocol::TelemetrySample> samples;
+    QString text;
+    QByteArray payload;
+    quint32 imageId = 0;
+    quint32 totalSize = 0;
+    quint32 offset = 0;
+    quint8 codec = 0; // ImageCodec of Image and ImageChunk payloads
+};
+
+// Splits one connection's byte stream into frames. It has no I/O or Qt object
+// dependencies so that any ingest backend can feed it. Unrecognised bytes are
+// skipped up to the next known frame start and counted in droppedBytes().
+class FrameDecoder
+{
+public:
+    void append(const char* data, qsizetype size);
+    void append(const QByteArray& data) { append(data.constData(), data.size()); }
+    void reserve(qsizetype size) { _buffer.reserve(size); }
+
+    // Lets a backend read straight into the buffer: prepareAppend() returns
+    // room for size bytes, and commitAppend() keeps the first n of them.
+    char* prepareAppend(qsizetype size);
+    void commitAppend(qsizetype n);
+
+    // Returns false when the buffered bytes do not hold a complete frame.
+    bool next(DecodedFrame& frame);
+
+    qsizetype buffered() const { return _buffer.size() - _pos; }
+    quint64 droppedBytes() const { return _droppedBytes; }
+    quint64 droppedFrames() const { return _droppedFrames; }
+
+private:
+    QByteArray _buffer;
+    qsizetype _pos = 0;
+    qsizetype _appendPos = 0;
+    quint64 _droppedBytes = 0;
+    quint64 _droppedFrames = 0;
+
+    void resync();
+    void compact();
+};
+
+#endif // FRAMEDECODER_H
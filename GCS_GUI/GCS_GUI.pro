@@ -9,14 +9,41 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    FrameDecoder.cpp \
+    ImageArchive.cpp \
+    ImageGalleryDialog.cpp \
+    IngestServer.cpp \
     MyTCPServer.cpp \
+    TrackBenchmark.cpp \
+    TrackMapWidget.cpp \
+    TrackStore.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
+    FrameDecoder.h \
+    ImageArchive.h \
+    ImageGalleryDialog.h \
+    IngestServer.h \
     MyTCPServer.h \
+    TrackBenchmark.h \
+    TrackMapWidget.h \
+    TrackStore.h \
     mainwindow.h
 
+# Native epoll ingest backend (--ingest epoll) and its benchmark
+linux {
+    SOURCES += \
+        EpollIngestServer.cpp \
+        IngestBenchmark.cpp
+
+    HEADERS += \
+        EpollIngestServer.h \
+        IngestBenchmark.h
+}
+
+include(../common/common.pri)
+
 FORMS += \
     mainwindow.ui
 
@@ -0,0 +1,249 @@
+#include "ImageArchive.h"
+#include "ImageCodec.h"
+#include "Metrics.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+const quint32 INDEX_MAGIC = 0x47494458;  // "GIDX"
+const quint32 RECORD_MAGIC = 0x54484D42; // "THMB"
+const qint32 INDEX_VERSION = 1;
+
+QString indexPath(const QString& rootPath)
+{
+    return rootPath + "/thumbs.idx";
+}
+
+QString imagePath(const QString& rootPath, const QByteArray& hash, const QString& suffix)
+{
+    QString hex = QString::fromLatin1(hash.toHex());
+    return QString("%1/images/%2/%3.%4").arg(rootPath, hex.left(2), hex, suffix);
+}
+
+}
+
+ImageArchiveWriter::ImageArchiveWriter(const QString& rootPath, const QSet<QByteArray>& knownHashes)
+    : _rootPath(rootPath)
+    , _knownHashes(knownHashes)
+{
+}
+
+void ImageArchiveWriter::write(const QByteArray& data, const QString& suffix, const QImage& image)
+{
+    ScopedTiming timing(MetricsRegistry::instance().stage(Stage::ImageArchive).duration);
+    QByteArray encoded = data;
+    ImageCodec codec;
+    if (encoded.isEmpty() && ImageCodecs::fromName(suffix, codec)) {
+        encoded = ImageCodecs::encode(image, codec);
+    }
+    QByteArray hash = QCryptographicHash::hash(encoded, QCryptographicHash::Sha256);
+    if (_knownHashes.contains(hash)) {
+        return;
+    }
+
+    QString path = imagePath(_rootPath, hash, suffix);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(encoded) != encoded.size() || !file.commit()) {
+        qDebug() << "Failed to archive image to" << path << ":" << file.errorString();
+        return;
+    }
+
+    QByteArray thumbnail;
+    QBuffer buffer(&thumbnail);
+    buffer.open(QIODevice::WriteOnly);
+    image.scaled(ImageArchive::THUMBNAIL_SIZE, ImageArchive::THUMBNAIL_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+        .save(&buffer, "JPEG", 80);
+    buffer.close();
+
+    if (!_index.isOpen()) {
+        _index.setFileName(indexPath(_rootPath));
+        bool isNew = !_index.exists() || _index.size() == 0;
+        if (!_index.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qDebug() << "Failed to open thumbnail index:" << _index.errorString();
+            return;
+        }
+        if (isNew) {
+            QDataStream out(&_index);
+            out.setVersion(QDataStream::Qt_5_15);
+            out << INDEX_MAGIC << INDEX_VERSION;
+        }
+    }
+
+    ImageArchiveEntry entry;
+    entry.hash = hash;
+    entry.suffix = suffix;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    entry.size = image.size();
+    entry.thumbLength = thumbnail.size();
+
+    QDataStream out(&_index);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << RECORD_MAGIC << entry.hash << entry.suffix << entry.timestamp
+        << qint32(entry.size.width()) << qint32(entry.size.height()) << entry.thumbLength;
+    entry.thumbOffset = _index.pos();
+    out.writeRawData(thumbnail.constData(), thumbnail.size());
+    _index.flush();
+
+    _knownHashes.insert(hash);
+    emit entryWritten(entry);
+}
+
+ImageArchive::ImageArchive(const QString& rootPath, QObject *parent)
+    : QObject(parent)
+    , _rootPath(rootPath)
+{
+    qRegisterMetaType<ImageArchiveEntry>();
+    QDir().mkpath(_rootPath);
+    loadIndex();
+
+    QSet<QByteArray> knownHashes;
+    for (const auto& entry : _entries) {
+        knownHashes.insert(entry.hash);
+    }
+
+    _writer = new ImageArchiveWriter(_rootPath, knownHashes);
+    _writer->moveToThread(&_thread);
+    connect(_writer, &ImageArchiveWriter::entryWritten, this, &ImageArchive::writer_entryWritten);
+    _thread.setObjectName("ImageArchive");
+    _thread.start(QThread::LowPriority);
+    qDebug() << "Image archive at" << _rootPath << "with" << _entries.size() << "images";
+}
+
+ImageArchive::~ImageArchive()
+{
+    _thread.quit();
+    _thread.wait();
+    delete _writer;
+}
+
+void ImageArchive::store(const QByteArray& encoded, const QString& suffix, const QImage& image)
+{
+    StageMetrics& metrics = MetricsRegistry::instance().stage(Stage::ImageArchive);
+    if (_pending.load(std::memory_order_relaxed) >= MAX_PENDING) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        metrics.drops.add();
+        return;
+    }
+    _pending.fetch_add(1, std::memory_order_relaxed);
+    metrics.queueDepth.add(1);
+    QMetaObject::invokeMethod(_writer, [this, encoded, suffix, image]() {
+        _writer->write(encoded, suffix, image);
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        MetricsRegistry::instance().stage(Stage::ImageArchive).queueDepth.add(-1);
+    }, Qt::QueuedConnection);
+}
+
+QString ImageArchive::rootPath() const
+{
+    return _rootPath;
+}
+
+int ImageArchive::count() const
+{
+    return _entries.size();
+}
+
+const ImageArchiveEntry& ImageArchive::entry(int row) const
+{
+    return _entries.at(row);
+}
+
+int ImageArchive::pendingWrites() const
+{
+    return _pending.load(std::memory_order_relaxed);
+}
+
+int ImageArchive::droppedWrites() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+QImage ImageArchive::loadThumbnail(int row)
+{
+    const ImageArchiveEntry& entry = _entries.at(row);
+    if (!_indexReader.isOpen()) {
+        _indexReader.setFileName(indexPath(_rootPath));
+        if (!_indexReader.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            return QImage();
+        }
+    }
+    if (!_indexReader.seek(entry.thumbOffset)) {
+        return QImage();
+    }
+    QImage thumbnail;
+    thumbnail.loadFromData(_indexReader.read(entry.thumbLength), "JPG");
+    return thumbnail;
+}
+
+QImage ImageArchive::loadImage(int row) const
+{
+    const ImageArchiveEntry& entry = _entries.at(row);
+    QString path = imagePath(_rootPath, entry.hash, entry.suffix);
+    ImageCodec codec;
+    if (ImageCodecs::fromName(entry.suffix, codec) && codec != ImageCodec::Jpeg) {
+        // Formats QImageReader has no plugin for
+        QFile file(path);
+        return file.open(QIODevice::ReadOnly) ? ImageCodecs::decode(file.readAll(), codec) : QImage();
+    }
+    return QImage(path);
+}
+
+void ImageArchive::writer_entryWritten(const ImageArchiveEntry& entry)
+{
+    _entries.append(entry);
+    emit entryAdded(_entries.size() - 1);
+}
+
+void ImageArchive::loadIndex()
+{
+    QFile file(indexPath(_rootPath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic;
+    qint32 version;
+    in >> magic >> version;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION) {
+        qDebug() << "Ignoring thumbnail index with unknown format:" << file.fileName();
+        return;
+    }
+
+    // Only record headers are read; thumbnails are skipped and paged in later.
+    // A torn record at the end (crash while appending) is cut off so that new
+    // records are appended after the last valid one.
+    qint64 validEnd = file.pos();
+    while (!in.atEnd()) {
+        ImageArchiveEntry entry;
+        quint32 recordMagic;
+        qint32 width, height;
+        in >> recordMagic >> entry.hash >> entry.suffix >> entry.timestamp >> width >> height >> entry.thumbLength;
+        if (in.status() != QDataStream::Ok || recordMagic != RECORD_MAGIC) {
+            break;
+        }
+        entry.size = QSize(width, height);
+        entry.thumbOffset = file.pos();
+        if (entry.thumbOffset + entry.thumbLength > file.size() || !file.seek(entry.thumbOffset + entry.thumbLength)) {
+            break;
+        }
+        _entries.append(entry);
+        validEnd = file.pos();
+    }
+
+    if (validEnd < file.size()) {
+        qDebug() << "Truncating torn thumbnail index record at offset" << validEnd;
+        file.close();
+        QFile::resize(indexPath(_rootPath), validEnd);
+    }
+}
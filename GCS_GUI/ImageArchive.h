@@ -0,0 +1,91 @@
+#ifndef IMAGEARCHIVE_H
+#define IMAGEARCHIVE_H
+
+#include <QObject>
+#include <QThread>
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <QSet>
+#include <QFile>
+#include <QMetaType>
+#include <atomic>
+
+// One record of the thumbnail index. Only offsets are kept in memory, the
+// thumbnail bytes stay on disk until the gallery asks for them.
+struct ImageArchiveEntry {
+    QByteArray hash;        // SHA-256 of the encoded image, also the file name
+    QString suffix;         // file extension of the stored image
+    qint64 timestamp = 0;   // msecs since epoch when the image was received
+    QSize size;             // dimensions of the full image
+    qint64 thumbOffset = 0; // offset of the thumbnail JPEG in the index file
+    quint32 thumbLength = 0;
+};
+Q_DECLARE_METATYPE(ImageArchiveEntry)
+
+// Runs on the archive thread: hashes, deduplicates, writes the image file and
+// appends the thumbnail record to the index.
+class ImageArchiveWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    ImageArchiveWriter(const QString& rootPath, const QSet<QByteArray>& knownHashes);
+    void write(const QByteArray& encoded, const QString& suffix, const QImage& image);
+
+signals:
+    void entryWritten(const ImageArchiveEntry& entry);
+
+private:
+    QString _rootPath;
+    QSet<QByteArray> _knownHashes;
+    QFile _index;
+};
+
+class ImageArchive : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageArchive(const QString& rootPath, QObject *parent = nullptr);
+    ~ImageArchive();
+
+    // Queues an image for the archive thread. Never blocks; drops the image
+    // when more than MAX_PENDING writes are already queued. With no encoded
+    // bytes the archive thread encodes the image with the ImageCodec named
+    // by suffix.
+    void store(const QByteArray& encoded, const QString& suffix, const QImage& image);
+
+    QString rootPath() const;
+    int count() const;
+    const ImageArchiveEntry& entry(int row) const;
+    int pendingWrites() const;
+    int droppedWrites() const;
+
+    QImage loadThumbnail(int row);
+    QImage loadImage(int row) const;
+
+    static const int THUMBNAIL_SIZE = 160;
+    static const int MAX_PENDING = 32;
+
+signals:
+    void entryAdded(int row);
+
+private slots:
+    void writer_entryWritten(const ImageArchiveEntry& entry);
+
+private:
+    QString _rootPath;
+    QVector<ImageArchiveEntry> _entries;
+    QFile _indexReader;
+    QThread _thread;
+    ImageArchiveWriter* _writer;
+    std::atomic<int> _pending{0};
+    std::atomic<int> _dropped{0};
+
+    void loadIndex();
+};
+
+#endif // IMAGEARCHIVE_H
@@ -0,0 +1,121 @@
+#include "ImageGalleryDialog.h"
+
+#include <QDateTime>
+#include <QHBoxLayout>
+#include <QResizeEvent>
+
+ImageGalleryModel::ImageGalleryModel(ImageArchive* archive, QObject *parent)
+    : QAbstractListModel(parent)
+    , _archive(archive)
+    , _thumbnails(MAX_CACHED_THUMBNAILS)
+{
+    connect(_archive, &ImageArchive::entryAdded, this, &ImageGalleryModel::archive_entryAdded);
+}
+
+int ImageGalleryModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : _archive->count();
+}
+
+QVariant ImageGalleryModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= _archive->count()) {
+        return QVariant();
+    }
+
+    const ImageArchiveEntry& entry = _archive->entry(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return QDateTime::fromMSecsSinceEpoch(entry.timestamp).toString("yyyy-MM-dd hh:mm:ss");
+    case Qt::ToolTipRole:
+        return QString("%1x%2, %3").arg(entry.size.width()).arg(entry.size.height())
+            .arg(QString::fromLatin1(entry.hash.toHex().left(12)));
+    case Qt::DecorationRole: {
+        if (QPixmap* cached = _thumbnails.object(index.row())) {
+            return *cached;
+        }
+        QImage thumbnail = _archive->loadThumbnail(index.row());
+        if (thumbnail.isNull()) {
+            return QVariant();
+        }
+        QPixmap* pixmap = new QPixmap(QPixmap::fromImage(thumbnail));
+        _thumbnails.insert(index.row(), pixmap);
+        return *pixmap;
+    }
+    case Qt::SizeHintRole:
+        return QSize(ImageArchive::THUMBNAIL_SIZE + 16, ImageArchive::THUMBNAIL_SIZE + 32);
+    default:
+        return QVariant();
+    }
+}
+
+void ImageGalleryModel::archive_entryAdded(int row)
+{
+    beginInsertRows(QModelIndex(), row, row);
+    endInsertRows();
+}
+
+ImageGalleryDialog::ImageGalleryDialog(ImageArchive* archive, QWidget *parent)
+    : QDialog(parent)
+    , _archive(archive)
+    , _images(MAX_CACHED_IMAGE_KB)
+{
+    setWindowTitle("Image Gallery");
+    resize(1100, 700);
+
+    _model = new ImageGalleryModel(_archive, this);
+
+    _view = new QListView(this);
+    _view->setViewMode(QListView::IconMode);
+    _view->setIconSize(QSize(ImageArchive::THUMBNAIL_SIZE, ImageArchive::THUMBNAIL_SIZE));
+    _view->setResizeMode(QListView::Adjust);
+    _view->setMovement(QListView::Static);
+    _view->setUniformItemSizes(true);
+    _view->setLayoutMode(QListView::Batched);
+    _view->setMinimumWidth(2 * (ImageArchive::THUMBNAIL_SIZE + 24));
+    _view->setModel(_model);
+    connect(_view->selectionModel(), &QItemSelectionModel::currentChanged, this, &ImageGalleryDialog::view_currentChanged);
+
+    _preview = new QLabel("Select an image", this);
+    _preview->setAlignment(Qt::AlignCenter);
+    _preview->setMinimumSize(350, 300);
+
+    auto layout = new QHBoxLayout(this);
+    layout->addWidget(_view, 1);
+    layout->addWidget(_preview, 2);
+}
+
+void ImageGalleryDialog::view_currentChanged(const QModelIndex& current)
+{
+    if (!current.isValid()) {
+        return;
+    }
+
+    int row = current.row();
+    if (QImage* cached = _images.object(row)) {
+        _currentImage = *cached;
+    } else {
+        _currentImage = _archive->loadImage(row);
+        if (_currentImage.isNull()) {
+            _preview->setText("Failed to load image");
+            return;
+        }
+        int cost = qMax<int>(1, _currentImage.sizeInBytes() / 1024);
+        _images.insert(row, new QImage(_currentImage), cost);
+    }
+    showPreview();
+}
+
+void ImageGalleryDialog::resizeEvent(QResizeEvent* event)
+{
+    QDialog::resizeEvent(event);
+    showPreview();
+}
+
+void ImageGalleryDialog::showPreview()
+{
+    if (_currentImage.isNull()) {
+        return;
+    }
+    _preview->setPixmap(QPixmap::fromImage(_currentImage).scaled(_preview->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+}
@@ -0,0 +1,61 @@
+#ifndef IMAGEGALLERYDIALOG_H
+#define IMAGEGALLERYDIALOG_H
+
+#include <QDialog>
+#include <QAbstractListModel>
+#include <QCache>
+#include <QPixmap>
+#include <QImage>
+#include <QLabel>
+#include <QListView>
+#include "ImageArchive.h"
+
+// List model over the archive index. Thumbnails are read from the index file
+// only when a delegate asks for them (i.e. when the row scrolls into view) and
+// are kept in a bounded cache.
+class ImageGalleryModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit ImageGalleryModel(ImageArchive* archive, QObject *parent = nullptr);
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    static const int MAX_CACHED_THUMBNAILS = 512;
+
+private slots:
+    void archive_entryAdded(int row);
+
+private:
+    ImageArchive* _archive;
+    mutable QCache<int, QPixmap> _thumbnails;
+};
+
+class ImageGalleryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ImageGalleryDialog(ImageArchive* archive, QWidget *parent = nullptr);
+
+    static const int MAX_CACHED_IMAGE_KB = 128 * 1024;
+
+protected:
+    void resizeEvent(QResizeEvent* event) override;
+
+private slots:
+    void view_currentChanged(const QModelIndex& current);
+
+private:
+    ImageArchive* _archive;
+    ImageGalleryModel* _model;
+    QListView* _view;
+    QLabel* _preview;
+    QCache<int, QImage> _images; // cost is the decoded size in KB
+    QImage _currentImage;
+
+    void showPreview();
+};
+
+#endif // IMAGEGALLERYDIALOG_H
@@ -0,0 +1,217 @@
+#include "IngestBenchmark.h"
+#include "IngestServer.h"
+#include "Protocol.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const int ACCEPT_TIMEOUT_MS = 60000;
+const int DRAIN_TIMEOUT_MS = 5000;
+
+struct Generator {
+    std::atomic<int> opened{-1};        // connections opened, once all were tried
+    std::atomic<bool> go{false};        // all accepted, start sending
+    std::atomic<bool> finished{false};  // sending done, sent and cpuNs valid
+    std::atomic<bool> release{false};   // counted, close the connections
+    quint64 sent = 0;
+    qint64 cpuNs = 0;                   // generator thread, while sending
+};
+
+qint64 cpuNs(int who)
+{
+    rusage usage;
+    getrusage(who, &usage);
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+        + (qint64(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+// Opens connectionCount loopback connections, then sends rate telemetry lines
+// per second on each, spread evenly over time and round-robin.
+void generate(quint16 port, int connectionCount, int seconds, int rate, Generator& generator)
+{
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    std::vector<int> fds;
+    for (int i = 0; i < connectionCount; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            break;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ::close(fd);
+            break;
+        }
+        fds.push_back(fd);
+    }
+    generator.opened = int(fds.size());
+    while (!generator.go) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    Protocol::TelemetrySample sample;
+    sample.latitude = 28.6139f;
+    sample.longitude = 77.2090f;
+    sample.altitude = 120.0f;
+    QByteArray line = (Protocol::formatTelemetry(sample) + "\n").toUtf8();
+
+    qint64 cpuStart = cpuNs(RUSAGE_THREAD);
+    double perNs = double(rate) * fds.size() / 1e9;
+    qint64 duration = qint64(seconds) * 1000000000LL;
+    quint64 attempted = 0;
+    size_t next = 0;
+    QElapsedTimer clock;
+    clock.start();
+    for (qint64 elapsed = 0; !fds.empty() && elapsed < duration; elapsed = clock.nsecsElapsed()) {
+        quint64 due = quint64(elapsed * perNs);
+        for (; attempted < due; ++attempted) {
+            if (::send(fds[next], line.constData(), line.size(), MSG_NOSIGNAL) == line.size()) {
+                ++generator.sent;
+            }
+            next = (next + 1) % fds.size();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    generator.cpuNs = cpuNs(RUSAGE_THREAD) - cpuStart;
+    generator.finished = true;
+
+    while (!generator.release) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+
+// Runs the event loop until done() or the timeout.
+bool waitFor(const std::function<bool()>& done, int timeoutMs)
+{
+    QTimer tick;
+    tick.start(5);
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+// Both ends of every connection live in this process.
+rlim_t raiseFileLimit()
+{
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return limit.rlim_cur;
+}
+
+void quietMessageHandler(QtMsgType type, const QMessageLogContext&, const QString& message)
+{
+    // The servers log every connection; keep warnings only.
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        fprintf(stderr, "%s\n", qPrintable(message));
+    }
+}
+
+}
+
+int runIngestBenchmark(const QList<int>& connectionCounts, int seconds, int rate, QTextStream& out)
+{
+    if (connectionCounts.isEmpty() || seconds <= 0 || rate <= 0) {
+        out << "Usage: --bench-ingest [connection counts, e.g. 100,1000,4000] [seconds] [rate Hz]\n";
+        return 1;
+    }
+    rlim_t fileLimit = raiseFileLimit();
+    QtMessageHandler previousHandler = qInstallMessageHandler(quietMessageHandler);
+
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+               .arg("backend", -8).arg("conns", 6).arg("accept ms", 10).arg("sent", 9)
+               .arg("delivered", 9).arg("lost %", 7).arg("CPU %", 6).arg("us/msg", 7);
+
+    int result = 0;
+    for (const QString& backend : IngestServer::backends()) {
+        for (int connectionCount : connectionCounts) {
+            if (rlim_t(connectionCount) * 2 + 64 > fileLimit) {
+                out << QString("%1 %2 skipped, needs %3 file descriptors, limit is %4\n")
+                           .arg(backend, -8).arg(connectionCount, 6).arg(connectionCount * 2 + 64).arg(fileLimit);
+                continue;
+            }
+
+            std::unique_ptr<IngestServer> server(IngestServer::create(backend, 0));
+            if (!server->isStarted()) {
+                out << "Cannot start the " << backend << " backend\n";
+                result = 1;
+                continue;
+            }
+            int connected = 0;
+            quint64 delivered = 0;
+            QObject::connect(server.get(), &IngestServer::newClientConnected, [&connected]() {
+                ++connected;
+            });
+            QObject::connect(server.get(), &IngestServer::telemetryReceived, [&delivered](float, float, float) {
+                ++delivered;
+            });
+
+            Generator generator;
+            QElapsedTimer timer;
+            timer.start();
+            std::thread thread(generate, server->port(), connectionCount, seconds, rate, std::ref(generator));
+
+            bool accepted = waitFor([&]() {
+                return generator.opened >= 0 && connected >= generator.opened;
+            }, ACCEPT_TIMEOUT_MS);
+            double acceptMs = timer.nsecsElapsed() / 1e6;
+
+            // Server CPU is the process's minus the generator thread's.
+            qint64 processCpuStart = cpuNs(RUSAGE_SELF);
+            timer.restart();
+            generator.go = true;
+            waitFor([&]() { return generator.finished.load(); }, seconds * 1000 + ACCEPT_TIMEOUT_MS);
+            waitFor([&]() { return delivered >= generator.sent; }, DRAIN_TIMEOUT_MS);
+            qint64 serverCpuNs = cpuNs(RUSAGE_SELF) - processCpuStart - generator.cpuNs;
+            qint64 wallNs = timer.nsecsElapsed();
+
+            generator.release = true;
+            thread.join();
+            waitFor([&]() { return server->connectionCount() == 0; }, DRAIN_TIMEOUT_MS);
+
+            double lost = generator.sent > 0 ? 100.0 * (double(generator.sent) - delivered) / generator.sent : 0;
+            out << QString("%1 %2 %3 %4 %5 %6 %7 %8")
+                       .arg(backend, -8).arg(generator.opened.load(), 6)
+                       .arg(acceptMs, 10, 'f', 1).arg(generator.sent, 9).arg(delivered, 9)
+                       .arg(lost, 7, 'f', 2)
+                       .arg(100.0 * serverCpuNs / wallNs, 6, 'f', 1)
+                       .arg(delivered > 0 ? serverCpuNs / 1000.0 / delivered : 0.0, 7, 'f', 2);
+            if (!accepted) {
+                out << "  (not all connections accepted)";
+            }
+            out << "\n";
+            out.flush();
+        }
+    }
+
+    qInstallMessageHandler(previousHandler);
+    return result;
+}
@@ -0,0 +1,15 @@
+#ifndef INGESTBENCHMARK_H
+#define INGESTBENCHMARK_H
+
+#include <QList>
+#include <QTextStream>
+
+// For each ingest backend and each connection count, opens that many
+// loopback connections, sends telemetry lines on all of them at rate Hz for
+// the given number of seconds, and reports accept time, frames delivered as
+// telemetryReceived and the server's CPU use. Linux only, since it compares
+// against the epoll backend. Run with
+// --bench-ingest [counts, e.g. 100,1000,4000] [seconds] [rate].
+int runIngestBenchmark(const QList<int>& connectionCounts, int seconds, int rate, QTextStream& out);
+
+#endif // INGESTBENCHMARK_H
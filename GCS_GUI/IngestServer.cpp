@@ -0,0 +1,289 @@
+#include "IngestServer.h"
+#include "MyTCPServer.h"
+#ifdef Q_OS_LINUX
+#include "EpollIngestServer.h"
+#endif
+#include "BinaryLog.h"
+
+#include <QDateTime>
+#include <QThread>
+
+IngestServer::IngestServer(QObject *parent)
+    : QObject(parent)
+{
+    connect(&_partialImageTimer, &QTimer::timeout, this, &IngestServer::partialImageTimer_timeout);
+    _partialImageTimer.start(PARTIAL_IMAGE_TIMEOUT_MS / 4);
+
+    // Decoding runs off the GUI thread; leave a core for the GUI and I/O.
+    _decodePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    connect(&_feedbackTimer, &QTimer::timeout, this, &IngestServer::feedbackTimer_timeout);
+    _feedbackTimer.start(FEEDBACK_INTERVAL_MS);
+    _sinceFeedback.start();
+}
+
+IngestServer::~IngestServer()
+{
+    // Decode tasks post their results back to this object.
+    _decodePool.waitForDone();
+    for (const ConnectionState& connection : _connections) {
+        MetricsRegistry::instance().removeConnection(connection.metrics);
+    }
+}
+
+IngestServer* IngestServer::create(const QString& backend, int port, QObject *parent)
+{
+    if (backend == "qt") {
+        return new MyTCPServer(port, parent);
+    }
+#ifdef Q_OS_LINUX
+    if (backend == "epoll") {
+        return new EpollIngestServer(port, parent);
+    }
+#endif
+    return nullptr;
+}
+
+QStringList IngestServer::backends()
+{
+#ifdef Q_OS_LINUX
+    return {"qt", "epoll"};
+#else
+    return {"qt"};
+#endif
+}
+
+void IngestServer::sendToAll(QString message)
+{
+    QByteArray data = Protocol::encodeTextFrame(message);
+    const QList<quint64> ids = _connections.keys();
+    for (quint64 id : ids) {
+        sendFrame(id, data);
+    }
+}
+
+int IngestServer::connectionCount() const
+{
+    return _connections.size();
+}
+
+void IngestServer::addConnection(quint64 id, const QString& peerAddress, quint16 peerPort, const std::shared_ptr<ConnectionMetrics>& metrics)
+{
+    ConnectionState& connection = _connections[id];
+    connection.peerAddress = peerAddress;
+    // The protocol has no vehicle id yet, so a connection stands in for one.
+    connection.vehicle = QString("%1:%2").arg(peerAddress).arg(peerPort);
+    connection.metrics = metrics;
+    MetricsRegistry::instance().connectionsAccepted().add();
+    sendFrame(id, Protocol::encodeTextFrame("Welcome to this Server"));
+    // Vehicles that understand the offer switch from JPEG to whichever codec
+    // suits their link; older ones ignore it.
+    sendFrame(id, Protocol::encodeCodecOffer(ImageCodecs::supportedMask()));
+    emit newClientConnected();
+}
+
+void IngestServer::removeConnection(quint64 id)
+{
+    auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        return;
+    }
+    MetricsRegistry::instance().removeConnection(it->metrics);
+    _connections.erase(it);
+    emit clientDisconnect();
+}
+
+void IngestServer::handleFrame(quint64 id, DecodedFrame& frame)
+{
+    auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        return;
+    }
+    QString vehicle = it->vehicle;
+
+    switch (frame.type) {
+    case DecodedFrame::Telemetry: {
+        const Protocol::TelemetrySample& sample = frame.samples.first();
+        BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::GcsTelemetryParsed, BinaryLog::floatBits(sample.latitude),
+                     BinaryLog::floatBits(sample.longitude), BinaryLog::floatBits(sample.altitude));
+        emit dataReceived(frame.text);
+        emit telemetryReceived(sample.latitude, sample.longitude, sample.altitude);
+        emit vehicleTelemetryReceived(vehicle, frame.samples);
+        break;
+    }
+    case DecodedFrame::TelemetryBatch:
+        BLOG_INFO(BinaryLog::GcsTelemetryBatch, frame.samples.size());
+        emit telemetryBatchReceived(frame.samples);
+        emit vehicleTelemetryReceived(vehicle, frame.samples);
+        break;
+    case DecodedFrame::Text:
+        emit dataReceived(frame.text);
+        break;
+    case DecodedFrame::Image:
+        decodeImage(id, frame.payload, ImageCodec::Jpeg);
+        break;
+    case DecodedFrame::ImageChunk:
+        handleImageChunk(id, frame);
+        break;
+    }
+}
+
+void IngestServer::handleImageChunk(quint64 id, const DecodedFrame& frame)
+{
+    QHash<quint32, PartialImage>& peerImages = _partialImages[_connections.value(id).peerAddress];
+    auto it = peerImages.find(frame.imageId);
+    if (it == peerImages.end() || it->totalSize != frame.totalSize || it->codec != frame.codec) {
+        if (it == peerImages.end() && peerImages.size() >= MAX_PARTIAL_IMAGES) {
+            // Bounded memory: forget this vehicle's transfer that has been
+            // idle longest. The vehicle resends it when the ack goes back.
+            auto oldest = peerImages.begin();
+            for (auto candidate = peerImages.begin(); candidate != peerImages.end(); ++candidate) {
+                if (candidate->lastUpdate < oldest->lastUpdate) {
+                    oldest = candidate;
+                }
+            }
+            peerImages.erase(oldest);
+            MetricsRegistry::instance().stage(Stage::ImageDecode).drops.add();
+        }
+        it = peerImages.insert(frame.imageId, PartialImage());
+        it->totalSize = frame.totalSize;
+        it->codec = frame.codec;
+        it->data.reserve(frame.totalSize);
+    }
+
+    // Chunks before the acknowledged offset are retransmissions after a
+    // reconnect; chunks beyond it are ignored and re-requested by the ack.
+    PartialImage& partial = *it;
+    quint32 received = partial.data.size();
+    quint32 chunkEnd = frame.offset + frame.payload.size();
+    if (frame.offset <= received && chunkEnd > received) {
+        partial.data.append(frame.payload.constData() + (received - frame.offset), chunkEnd - received);
+    }
+    partial.lastUpdate = QDateTime::currentMSecsSinceEpoch();
+
+    received = partial.data.size();
+    BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::GcsImageAck, frame.imageId, received, partial.totalSize);
+    sendFrame(id, Protocol::encodeImageAck(frame.imageId, received));
+
+    if (received == partial.totalSize) {
+        QByteArray imageData = partial.data;
+        ImageCodec codec = ImageCodec(partial.codec);
+        peerImages.erase(it);
+        decodeImage(id, imageData, codec);
+    }
+}
+
+void IngestServer::decodeImage(quint64 id, const QByteArray& imageData, ImageCodec codec)
+{
+    auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        return;
+    }
+    StageMetrics& stage = MetricsRegistry::instance().stage(Stage::ImageDecode);
+
+    // A vehicle that sends faster than we decode loses images here rather
+    // than growing an unbounded queue; the loss is reported back to it.
+    if (it->pendingDecodes >= MAX_PENDING_DECODES) {
+        ++it->droppedImages;
+        stage.drops.add();
+        return;
+    }
+    ++it->pendingDecodes;
+    stage.queueDepth.add(1);
+
+    QElapsedTimer queued;
+    queued.start();
+    _decodePool.start([this, id, imageData, codec, queued]() {
+        QImage image;
+        {
+            ScopedTiming decodeTiming(MetricsRegistry::instance().stage(Stage::ImageDecode).duration);
+            image = ImageCodecs::decode(imageData, codec);
+        }
+        qint64 latencyNs = queued.nsecsElapsed();
+        QMetaObject::invokeMethod(this, [this, id, imageData, codec, image, latencyNs]() {
+            imageDecoded(id, imageData, codec, image, latencyNs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void IngestServer::imageDecoded(quint64 id, const QByteArray& imageData, ImageCodec codec, const QImage& image, qint64 latencyNs)
+{
+    MetricsRegistry::instance().stage(Stage::ImageDecode).queueDepth.add(-1);
+
+    // The connection may have gone away while the image was decoding.
+    auto it = _connections.find(id);
+    if (it != _connections.end()) {
+        --it->pendingDecodes;
+        it->decodeLatencyNs += latencyNs;
+        ++it->decodedSinceFeedback;
+    }
+
+    if (!image.isNull()) {
+        BLOG_INFO(BinaryLog::GcsImageDecoded, image.width(), image.height(), imageData.size());
+        emit imageReceived(image);
+        emit imageDataReceived(imageData, codec, image);
+    } else {
+        BLOG_WARN(BinaryLog::GcsCodedImageDecodeFailed, imageData.size(), quint8(codec), BinaryLog::prefix(imageData));
+        MetricsRegistry::instance().stage(Stage::ImageDecode).drops.add();
+        if (it != _connections.end()) {
+            ++it->droppedImages;
+        }
+    }
+}
+
+void IngestServer::feedbackTimer_timeout()
+{
+    qint64 elapsedMs = qMax<qint64>(1, _sinceFeedback.restart());
+    for (auto it = _connections.begin(); it != _connections.end(); ++it) {
+        ConnectionState& connection = it.value();
+        quint64 bytesIn = connection.metrics->bytesIn.value();
+
+        Protocol::LinkFeedback feedback;
+        feedback.rxBytesPerSecond = quint32((bytesIn - connection.feedbackBytesIn) * 1000 / elapsedMs);
+        feedback.decodeQueueDepth = connection.pendingDecodes;
+        feedback.droppedImages = connection.droppedImages;
+        feedback.decodeLatencyMs = connection.decodedSinceFeedback > 0
+            ? quint32(connection.decodeLatencyNs / connection.decodedSinceFeedback / 1000000) : 0;
+
+        connection.feedbackBytesIn = bytesIn;
+        connection.decodeLatencyNs = 0;
+        connection.decodedSinceFeedback = 0;
+        sendFrame(it.key(), Protocol::encodeLinkFeedback(feedback));
+    }
+}
+
+void IngestServer::partialImageTimer_timeout()
+{
+    // Partial images outlive their connection so that a reconnecting vehicle
+    // can resume, but not forever.
+    qint64 expired = QDateTime::currentMSecsSinceEpoch() - PARTIAL_IMAGE_TIMEOUT_MS;
+    for (auto peer = _partialImages.begin(); peer != _partialImages.end();) {
+        for (auto image = peer->begin(); image != peer->end();) {
+            if (image->lastUpdate < expired) {
+                image = peer->erase(image);
+                MetricsRegistry::instance().stage(Stage::ImageDecode).drops.add();
+            } else {
+                ++image;
+            }
+        }
+        if (peer->isEmpty()) {
+            peer = _partialImages.erase(peer);
+        } else {
+            ++peer;
+        }
+    }
+}
+
+void IngestServer::sendFrame(quint64 id, const QByteArray& frame)
+{
+    auto it = _connections.find(id);
+    if (it == _connections.end()) {
+        return;
+    }
+    qint64 written = writeFrame(id, frame);
+    if (written < 0) {
+        it->metrics->drops.add();
+    } else {
+        it->metrics->bytesOut.add(written);
+        it->metrics->framesOut.add();
+    }
+}
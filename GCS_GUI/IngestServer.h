@@ -0,0 +1,106 @@
+#ifndef INGESTSERVER_H
+#define INGESTSERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <memory>
+#include "FrameDecoder.h"
+#include "ImageCodec.h"
+#include "Metrics.h"
+#include "Protocol.h"
+
+// The part of the GCS server that does not depend on how bytes arrive: it
+// turns decoded frames into signals, reassembles chunked images, decodes
+// them on a thread pool and sends acks, the codec offer and link feedback
+// back through the transport. Transports (MyTCPServer, EpollIngestServer)
+// own the sockets and a FrameDecoder per connection, and call
+// addConnection(), handleFrame() and removeConnection() on this object's
+// thread.
+class IngestServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IngestServer(QObject *parent = nullptr);
+    ~IngestServer();
+
+    // backend is "qt" (MyTCPServer) or, on Linux, "epoll" (EpollIngestServer);
+    // returns nullptr for anything else.
+    static IngestServer* create(const QString& backend, int port, QObject *parent = nullptr);
+    static QStringList backends();
+
+    virtual bool isStarted() const = 0;
+    virtual quint16 port() const = 0;
+    void sendToAll(QString message);
+    int connectionCount() const;
+
+signals:
+    void newClientConnected();
+    void clientDisconnect();
+    void dataReceived(QString data);
+    void telemetryReceived(float latitude, float longitude, float altitude);
+    void telemetryBatchReceived(const QVector<Protocol::TelemetrySample>& samples); // Backlog sent after a reconnect
+    void vehicleTelemetryReceived(const QString& vehicle, const QVector<Protocol::TelemetrySample>& samples); // Live and backlog, by connection ("address:port")
+    void imageReceived(const QImage& image); // New signal for image reception
+    void imageDataReceived(const QByteArray& imageData, ImageCodec codec, const QImage& image); // Encoded bytes, for archiving
+
+protected:
+    // id must be unique for the lifetime of the server.
+    void addConnection(quint64 id, const QString& peerAddress, quint16 peerPort, const std::shared_ptr<ConnectionMetrics>& metrics);
+    void removeConnection(quint64 id);
+    void handleFrame(quint64 id, DecodedFrame& frame);
+    void sendFrame(quint64 id, const QByteArray& frame);
+
+    // Queues bytes on the connection; returns the number accepted or -1.
+    virtual qint64 writeFrame(quint64 id, const QByteArray& frame) = 0;
+
+private slots:
+    void feedbackTimer_timeout();
+    void partialImageTimer_timeout();
+
+private:
+    // Image being received in chunks. Keyed by peer address and image id, not
+    // by connection, so that a transfer survives the vehicle reconnecting.
+    struct PartialImage {
+        QByteArray data;
+        quint32 totalSize = 0;
+        quint8 codec = 0;
+        qint64 lastUpdate = 0;
+    };
+
+    struct ConnectionState {
+        QString peerAddress;
+        QString vehicle; // peer address and port of this connection
+        std::shared_ptr<ConnectionMetrics> metrics;
+        int pendingDecodes = 0;
+        quint32 droppedImages = 0;
+        quint64 feedbackBytesIn = 0;    // bytesIn at the last feedback
+        qint64 decodeLatencyNs = 0;     // since the last feedback
+        int decodedSinceFeedback = 0;
+    };
+
+    QHash<quint64, ConnectionState> _connections;
+    QHash<QString, QHash<quint32, PartialImage>> _partialImages; // by peer address, then image id
+    QTimer _partialImageTimer;
+    QThreadPool _decodePool;
+    QTimer _feedbackTimer;
+    QElapsedTimer _sinceFeedback;
+
+    void handleImageChunk(quint64 id, const DecodedFrame& frame);
+    void decodeImage(quint64 id, const QByteArray& imageData, ImageCodec codec);
+    void imageDecoded(quint64 id, const QByteArray& imageData, ImageCodec codec, const QImage& image, qint64 latencyNs);
+
+    static constexpr int MAX_PARTIAL_IMAGES = 8; // per peer
+    static constexpr int PARTIAL_IMAGE_TIMEOUT_MS = 120000;
+    static constexpr int MAX_PENDING_DECODES = 4; // per connection
+    static constexpr int FEEDBACK_INTERVAL_MS = 1000;
+};
+
+#endif // INGESTSERVER_H
@@ -1,9 +1,8 @@
 #include "MyTCPServer.h"
-
-const quint32 MyTCPServer::IMAGE_HEADER;
+#include "BinaryLog.h"
 
 MyTCPServer::MyTCPServer(int port, QObject *parent)
-    : QObject(parent)
+    : IngestServer(parent)
 {
     _server = new QTcpServer(this);
     connect(_server, &QTcpServer::newConnection, this, &MyTCPServer::on_client_connecting);
@@ -21,14 +20,23 @@ void MyTCPServer::on_client_connecting()
     auto socket = _server->nextPendingConnection();
     connect(socket, &QTcpSocket::readyRead, this, &MyTCPServer::clientDataReady);
     connect(socket, &QTcpSocket::disconnected, this, &MyTCPServer::clientDisconnected);
-    _socketsList.append(socket);
-    socket->write("Welcome to this Server");
-    emit newClientConnected();
+    SocketState& state = _sockets[socket];
+    state.id = _nextConnectionId++;
+    state.metrics = MetricsRegistry::instance().addConnection(
+        QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()));
+    _socketsById.insert(state.id, socket);
+    addConnection(state.id, socket->peerAddress().toString(), socket->peerPort(), state.metrics);
 }
 
 void MyTCPServer::clientDisconnected()
 {
-    emit clientDisconnect();
+    auto socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket) {
+        quint64 id = _sockets.take(socket).id;
+        _socketsById.remove(id);
+        socket->deleteLater();
+        removeConnection(id);
+    }
 }
 
 void MyTCPServer::clientDataReady()
@@ -43,97 +51,51 @@ void MyTCPServer::clientDataReady()
         return;
     }
 
-    qDebug() << "Received raw buffer, size:" << buffer.size() << ", first few bytes:" << buffer.left(16).toHex();
-
-    QString data(buffer);
-    if (data.startsWith("Latitude:")) {
-        qDebug() << "Received telemetry data:" << data.left(100);
-        emit dataReceived(data);
-        if (data.contains("Longitude:") && data.contains("Altitude:")) {
-            QStringList parts = data.split(", ");
-            if (parts.size() == 3) {
-                bool ok;
-                float latitude = parts[0].split(": ")[1].toFloat(&ok);
-                if (ok) {
-                    float longitude = parts[1].split(": ")[1].toFloat(&ok);
-                    if (ok) {
-                        float altitude = parts[2].split(": ")[1].toFloat(&ok);
-                        if (ok) {
-                            qDebug() << "Parsed telemetry: lat=" << latitude << ", lon=" << longitude << ", alt=" << altitude;
-                            emit telemetryReceived(latitude, longitude, altitude);
-                        }
-                    }
-                }
-            }
-        }
+    auto it = _sockets.find(socket);
+    if (it == _sockets.end()) {
         return;
     }
-    clientDataReadyImage(socket, buffer);
-}
-
-void MyTCPServer::clientDataReadyImage(QTcpSocket* socket, QByteArray& buffer)
-{
-    QDataStream in(&buffer, QIODevice::ReadOnly);
-    in.setVersion(QDataStream::Qt_5_15);
-
-    quint32 headerValue;
-    in >> headerValue;
-
-    if (headerValue == 0xA1B2C3D4) {
-        socketBuffers[socket].append(buffer);
-        QByteArray& imageBuffer = socketBuffers[socket];
-
-        qDebug() << "Processing image data, total buffer size:" << imageBuffer.size();
-
-
-        while (imageBuffer.size() >= sizeof(quint32) + sizeof(qint32)) {
-            QDataStream in(&imageBuffer, QIODevice::ReadOnly);
-            in.setVersion(QDataStream::Qt_5_15); // Match client version
-            quint32 header;
-            in >> header;
-            if (header != IMAGE_HEADER) {
-                qDebug() << "Invalid image header detected:" << QString::number(header, 16) << ", clearing buffer";
-                qDebug() << "Expected header: a1b2c3d4, received first 4 bytes:" << imageBuffer.left(4).toHex();
-                imageBuffer.clear();
-                socketBuffers.remove(socket);
-                return;
-            }
-
-            qint32 imageDataSize;
-            in >> imageDataSize;
-            qDebug() << "Read image data size:" << imageDataSize;
-
-            if (imageBuffer.size() - sizeof(quint32) - sizeof(qint32) < imageDataSize || imageDataSize <= 0) {
-                qDebug() << "Insufficient data for image, waiting, needed:" << (sizeof(quint32) + sizeof(qint32) + imageDataSize) << ", have:" << imageBuffer.size();
-                return;
-            }
-            imageBuffer.remove(0, sizeof(quint32) + sizeof(qint32));
-
-            QByteArray imageData = imageBuffer.left(imageDataSize);
-            imageBuffer.remove(0, imageDataSize);
-
-            QImage image;
-            if (image.loadFromData(imageData, "JPG")) {
-                qDebug() << "Successfully loaded QImage, dimensions:" << image.size();
-                emit imageReceived(image);
-                socketBuffers.remove(socket);
-            } else {
-                qDebug() << "Failed to load QImage from data, size:" << imageData.size() << ", first few bytes:" << imageData.left(16).toHex();
-                socketBuffers.remove(socket);
-            }
+    quint64 id = it->id;
+    auto metrics = it->metrics;
+    metrics->bytesIn.add(buffer.size());
+    BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::GcsBufferReceived, buffer.size(), quint64(socket->socketDescriptor()), BinaryLog::prefix(buffer));
+
+    FrameDecoder& decoder = it->decoder;
+    quint64 droppedBefore = decoder.droppedFrames();
+    decoder.append(buffer);
+
+    Timing& parseTiming = MetricsRegistry::instance().stage(Stage::TelemetryParse).duration;
+    DecodedFrame frame;
+    QElapsedTimer timer;
+    timer.start();
+    while (decoder.next(frame)) {
+        if (frame.type == DecodedFrame::Telemetry || frame.type == DecodedFrame::TelemetryBatch) {
+            parseTiming.record(timer.nsecsElapsed());
         }
+        metrics->framesIn.add();
+        // May emit signals whose slots close the socket; `decoder` stays valid
+        // because the state is only removed on disconnected().
+        handleFrame(id, frame);
+        timer.restart();
     }
+
+    metrics->bufferedBytes.set(decoder.buffered());
+    metrics->drops.add(decoder.droppedFrames() - droppedBefore);
+    BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::GcsImageChunk, decoder.buffered(), quint64(socket->socketDescriptor()));
 }
 
+qint64 MyTCPServer::writeFrame(quint64 id, const QByteArray& frame)
+{
+    QTcpSocket* socket = _socketsById.value(id);
+    return socket ? socket->write(frame) : -1;
+}
 
 bool MyTCPServer::isStarted() const
 {
     return _isStarted;
 }
 
-void MyTCPServer::sendToAll(QString message)
+quint16 MyTCPServer::port() const
 {
-    foreach (auto socket, _socketsList) {
-        socket->write(message.toUtf8());
-    }
+    return _server->serverPort();
 }
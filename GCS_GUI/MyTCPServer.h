@@ -5,41 +5,43 @@
 #include <QTcpSocket>
 #include <QObject>
 #include <QDebug>
-#include <QFile>
-#include <QPixmap>
 #include <QByteArray>
-#include <QLabel>
-#include <QImage>
+#include <QHash>
+#include <QMap>
+#include <memory>
+#include "IngestServer.h"
+#include "FrameDecoder.h"
 
-class MyTCPServer : public QObject
+// QTcpServer transport: one QTcpSocket per vehicle, read on the GUI thread.
+class MyTCPServer : public IngestServer
 {
     Q_OBJECT
 
 public:
     explicit MyTCPServer(int port, QObject *parent = nullptr);
-    bool isStarted() const;
-    void sendToAll(QString message);
+    bool isStarted() const override;
+    quint16 port() const override;
 
-signals:
-    void newClientConnected();
-    void clientDisconnect();
-    void dataReceived(QString data);
-    void telemetryReceived(float latitude, float longitude, float altitude);
-    void imageReceived(const QImage& image); // New signal for image reception
+protected:
+    qint64 writeFrame(quint64 id, const QByteArray& frame) override;
 
 private slots:
     void on_client_connecting();
     void clientDisconnected();
     void clientDataReady();
-    void clientDataReadyImage(QTcpSocket* socket, QByteArray& buffer);
 
 private:
+    struct SocketState {
+        quint64 id = 0;
+        FrameDecoder decoder;
+        std::shared_ptr<ConnectionMetrics> metrics;
+    };
+
     QTcpServer* _server;
     bool _isStarted;
-    QList<QTcpSocket*> _socketsList;
-    void processImageData(QTcpSocket* socket, QByteArray& buffer);
-    static const quint32 IMAGE_HEADER = 0xA1B2C3D4;
-    QMap<QTcpSocket*, QByteArray> socketBuffers; // Per-socket buffer for image data
+    QMap<QTcpSocket*, SocketState> _sockets;
+    QHash<quint64, QTcpSocket*> _socketsById;
+    quint64 _nextConnectionId = 1;
 };
 
 #endif // MYTCPSERVER_H
@@ -0,0 +1,116 @@
+#include "TrackBenchmark.h"
+#include "TrackMapWidget.h"
+#include "TrackStore.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QtMath>
+#include <cmath>
+
+namespace {
+
+const QSize VIEW_SIZE(1280, 800);
+const int FRAMES = 10;
+
+struct View {
+    const char* name;
+    QPointF center;
+    double zoom;
+};
+
+// Each vehicle flies a smooth random heading at about 2 m per sample, with
+// GPS noise of about 0.2 m, starting somewhere in a 2 x 2 degree area.
+void buildTracks(TrackStore& store, int trackCount, int pointsPerTrack)
+{
+    QRandomGenerator random(42);
+    for (int i = 0; i < trackCount; ++i) {
+        int index = store.addTrack(QString("vehicle-%1").arg(i));
+        double latitude = 27.6 + random.generateDouble() * 2;
+        double longitude = 76.2 + random.generateDouble() * 2;
+        double heading = random.generateDouble() * 2 * M_PI;
+        for (int j = 0; j < pointsPerTrack; ++j) {
+            heading += (random.generateDouble() - 0.5) * 0.1;
+            latitude += std::cos(heading) * 2e-5;
+            longitude += std::sin(heading) * 2e-5;
+            store.append(index, latitude + (random.generateDouble() - 0.5) * 4e-6,
+                         longitude + (random.generateDouble() - 0.5) * 4e-6);
+        }
+    }
+}
+
+double renderMs(QImage& image, const TrackStore& store, const View& view, bool fullDetail, int frames,
+                TrackRenderStats& stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; ++i) {
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        stats = TrackMapWidget::paintTracks(painter, store, view.center, view.zoom, image.size(), fullDetail);
+    }
+    return timer.nsecsElapsed() / 1e6 / frames;
+}
+
+}
+
+int runTrackBenchmark(int trackCount, int pointsPerTrack, QTextStream& out)
+{
+    if (trackCount <= 0 || pointsPerTrack <= 0) {
+        out << "Usage: --bench-tracks [tracks] [points per track]\n";
+        return 1;
+    }
+
+    TrackStore store;
+    QElapsedTimer timer;
+    timer.start();
+    buildTracks(store, trackCount, pointsPerTrack);
+    qint64 buildNs = timer.nsecsElapsed();
+    quint64 samples = store.pointCount(-1);
+    out << QString("%1 tracks x %2 samples, appended in %3 s (%4 ns/sample)\n")
+               .arg(trackCount).arg(pointsPerTrack).arg(buildNs / 1e9, 0, 'f', 2)
+               .arg(double(buildNs) / samples, 0, 'f', 1);
+
+    for (int level = 0; level < Track::LEVELS; ++level) {
+        quint64 points = store.pointCount(level);
+        out << QString("level %1 (zoom %2, %3 m): %4 points, %5% of samples, %6 MB\n")
+                   .arg(level).arg(TrackStore::levelZoom(level))
+                   .arg(TrackStore::tolerance(level) * 40075016.0 / TrackStore::WORLD_SIZE, 0, 'f', 2)
+                   .arg(points).arg(100.0 * points / samples, 0, 'f', 2)
+                   .arg(points * sizeof(TrackPoint) / 1e6, 0, 'f', 1);
+    }
+    out.flush();
+
+    TrackBounds all;
+    for (int i = 0; i < store.trackCount(); ++i) {
+        const TrackBounds& bounds = store.track(i).bounds();
+        all.extend(TrackPoint{ bounds.minX, bounds.minY });
+        all.extend(TrackPoint{ bounds.maxX, bounds.maxY });
+    }
+    double fitUnitsPerPixel = qMax(double(all.maxX - all.minX) / VIEW_SIZE.width(),
+                                   double(all.maxY - all.minY) / VIEW_SIZE.height());
+    TrackPoint focus = store.track(0).latest();
+    const View views[] = {
+        { "fleet", QPointF((all.minX + all.maxX) / 2.0, (all.minY + all.maxY) / 2.0),
+          std::log2(TrackStore::WORLD_SIZE / (256 * qMax(1.0, fitUnitsPerPixel))) },
+        { "city", QPointF(focus.x, focus.y), 13 },
+        { "street", QPointF(focus.x, focus.y), 18 },
+    };
+
+    QImage image(VIEW_SIZE, QImage::Format_ARGB32_Premultiplied);
+    out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+               .arg("view", -7).arg("zoom", 5).arg("level", 5).arg("tracks", 7)
+               .arg("points", 10).arg("LOD ms", 9).arg("full ms", 9);
+    for (const View& view : views) {
+        TrackRenderStats stats;
+        double lodMs = renderMs(image, store, view, false, FRAMES, stats);
+        TrackRenderStats fullStats;
+        double fullMs = renderMs(image, store, view, true, 1, fullStats);
+        out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+                   .arg(view.name, -7).arg(view.zoom, 5, 'f', 1).arg(stats.level, 5).arg(stats.tracks, 7)
+                   .arg(stats.points, 10).arg(lodMs, 9, 'f', 2).arg(fullMs, 9, 'f', 1);
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef TRACKBENCHMARK_H
+#define TRACKBENCHMARK_H
+
+#include <QTextStream>
+
+// Builds trackCount synthetic tracks of pointsPerTrack samples each and
+// times appending them and repainting the map at fleet, city and street
+// zoom, with level-of-detail and culling against drawing level 0 of every
+// track. Run with --bench-tracks [tracks] [points per track].
+int runTrackBenchmark(int trackCount, int pointsPerTrack, QTextStream& out);
+
+#endif // TRACKBENCHMARK_H
@@ -0,0 +1,215 @@
+#include "TrackMapWidget.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPolygonF>
+#include <QWheelEvent>
+#include <cmath>
+
+namespace {
+
+const QColor TRACK_COLORS[] = {
+    QColor(220, 50, 47), QColor(38, 139, 210), QColor(133, 153, 0), QColor(211, 54, 130),
+    QColor(42, 161, 152), QColor(203, 75, 22), QColor(108, 113, 196), QColor(181, 137, 0),
+};
+
+TrackBounds worldBounds(const QPointF& center, double unitsPerPixel, const QSize& size)
+{
+    TrackBounds bounds;
+    bounds.minX = qint32(qMax(0.0, center.x() - size.width() / 2.0 * unitsPerPixel));
+    bounds.maxX = qint32(qMin(double(TrackStore::WORLD_SIZE), center.x() + size.width() / 2.0 * unitsPerPixel));
+    bounds.minY = qint32(qMax(0.0, center.y() - size.height() / 2.0 * unitsPerPixel));
+    bounds.maxY = qint32(qMin(double(TrackStore::WORLD_SIZE), center.y() + size.height() / 2.0 * unitsPerPixel));
+    return bounds;
+}
+
+}
+
+TrackMapWidget::TrackMapWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(350, 300);
+}
+
+void TrackMapWidget::addSamples(const QString& vehicle, const QVector<Protocol::TelemetrySample>& samples)
+{
+    if (samples.isEmpty()) {
+        return;
+    }
+    int index = _tracks.indexOf(vehicle);
+    if (index < 0) {
+        index = _tracks.addTrack(vehicle);
+    }
+    for (const Protocol::TelemetrySample& sample : samples) {
+        _tracks.append(index, sample.latitude, sample.longitude);
+    }
+    _lastUpdatedTrack = index;
+    if (_followTrack < 0) {
+        _followTrack = index;
+    }
+    if (_follow && index == _followTrack) {
+        TrackPoint latest = _tracks.track(index).latest();
+        _center = QPointF(latest.x, latest.y);
+    }
+    update();
+}
+
+const TrackStore& TrackMapWidget::tracks() const
+{
+    return _tracks;
+}
+
+QString TrackMapWidget::followedVehicle() const
+{
+    return _followTrack >= 0 ? _tracks.vehicle(_followTrack) : QString();
+}
+
+void TrackMapWidget::setBackground(const QPixmap& pixmap, double latitude, double longitude, double zoom, const QSize& logicalSize)
+{
+    TrackPoint center = TrackStore::project(latitude, longitude);
+    double unitsPerPixel = TrackStore::unitsPerPixel(zoom);
+    QSizeF size(logicalSize.width() * unitsPerPixel, logicalSize.height() * unitsPerPixel);
+    _background = pixmap;
+    _backgroundWorld = QRectF(QPointF(center.x - size.width() / 2, center.y - size.height() / 2), size);
+    update();
+}
+
+bool TrackMapWidget::needsBackground(double latitude, double longitude) const
+{
+    if (_background.isNull()) {
+        return true;
+    }
+    TrackPoint p = TrackStore::project(latitude, longitude);
+    QRectF middle = _backgroundWorld.adjusted(_backgroundWorld.width() / 4, _backgroundWorld.height() / 4,
+                                              -_backgroundWorld.width() / 4, -_backgroundWorld.height() / 4);
+    return !middle.contains(QPointF(p.x, p.y));
+}
+
+TrackRenderStats TrackMapWidget::paintTracks(QPainter& painter, const TrackStore& store, const QPointF& center,
+                                             double zoom, const QSize& size, bool fullDetail)
+{
+    TrackRenderStats stats;
+    stats.level = fullDetail ? 0 : TrackStore::levelForZoom(zoom);
+    double unitsPerPixel = TrackStore::unitsPerPixel(zoom);
+    double scale = 1 / unitsPerPixel;
+    double originX = center.x() - size.width() / 2.0 * unitsPerPixel;
+    double originY = center.y() - size.height() / 2.0 * unitsPerPixel;
+    // A pen's width of margin so lines entering from off screen are kept.
+    TrackBounds view = worldBounds(center, unitsPerPixel, size + QSize(4, 4));
+
+    QPolygonF polyline;
+    QPen pen;
+    pen.setWidthF(2);
+    pen.setCosmetic(true);
+
+    for (int i = 0; i < store.trackCount(); ++i) {
+        const Track& track = store.track(i);
+        if (track.isEmpty() || (!fullDetail && !track.bounds().intersects(view))) {
+            continue;
+        }
+        pen.setColor(TRACK_COLORS[i % (sizeof(TRACK_COLORS) / sizeof(TRACK_COLORS[0]))]);
+        painter.setPen(pen);
+
+        bool visible = false;
+        for (const TrackChunk& chunk : track.chunks(stats.level)) {
+            if (!fullDetail && !chunk.bounds.intersects(view)) {
+                continue;
+            }
+            polyline.resize(chunk.points.size());
+            QPointF* out = polyline.data();
+            for (const TrackPoint& p : chunk.points) {
+                *out++ = QPointF((p.x - originX) * scale, (p.y - originY) * scale);
+            }
+            painter.drawPolyline(polyline);
+            ++stats.chunks;
+            stats.points += chunk.points.size();
+            visible = true;
+        }
+
+        // Samples the simplifier has not settled yet: what is pending at this
+        // level, then at each finer one, up to the live position.
+        polyline.clear();
+        for (int level = stats.level; level >= 0; --level) {
+            TrackPoint anchor = track.lastCommitted(level);
+            polyline.append(QPointF((anchor.x - originX) * scale, (anchor.y - originY) * scale));
+            for (const TrackPoint& p : track.pending(level)) {
+                polyline.append(QPointF((p.x - originX) * scale, (p.y - originY) * scale));
+            }
+        }
+        TrackPoint latest = track.latest();
+        QPointF head((latest.x - originX) * scale, (latest.y - originY) * scale);
+        polyline.append(head);
+        painter.drawPolyline(polyline);
+        painter.drawEllipse(head, 4, 4);
+        stats.points += polyline.size();
+        stats.tracks += visible ? 1 : 0;
+    }
+    return stats;
+}
+
+void TrackMapWidget::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(235, 235, 230));
+
+    if (!_background.isNull()) {
+        QRectF target(toScreen(_backgroundWorld.topLeft()), toScreen(_backgroundWorld.bottomRight()));
+        painter.drawPixmap(target, _background, _background.rect());
+    }
+
+    TrackRenderStats stats = paintTracks(painter, _tracks, _center, _zoom, size());
+
+    painter.setPen(Qt::black);
+    painter.drawText(rect().adjusted(6, 0, -6, -4), Qt::AlignBottom | Qt::AlignLeft,
+                     QString("zoom %1, detail level %2, %3 points")
+                         .arg(_zoom, 0, 'f', 1).arg(stats.level).arg(stats.points));
+}
+
+void TrackMapWidget::wheelEvent(QWheelEvent* event)
+{
+    double steps = event->angleDelta().y() / 120.0;
+    double zoom = qBound(MIN_ZOOM, _zoom + steps / 2, MAX_ZOOM);
+    if (zoom == _zoom) {
+        return;
+    }
+    // Keep the world point under the cursor where it is.
+    QPointF cursor = event->position() - QPointF(width() / 2.0, height() / 2.0);
+    QPointF world = _center + cursor * TrackStore::unitsPerPixel(_zoom);
+    _zoom = zoom;
+    if (!_follow) {
+        _center = world - cursor * TrackStore::unitsPerPixel(_zoom);
+    }
+    update();
+}
+
+void TrackMapWidget::mousePressEvent(QMouseEvent* event)
+{
+    _dragStart = event->pos();
+    _dragCenter = _center;
+}
+
+void TrackMapWidget::mouseMoveEvent(QMouseEvent* event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        _follow = false;
+        _center = _dragCenter - QPointF(event->pos() - _dragStart) * TrackStore::unitsPerPixel(_zoom);
+        update();
+    }
+}
+
+void TrackMapWidget::mouseDoubleClickEvent(QMouseEvent*)
+{
+    _follow = true;
+    _followTrack = _lastUpdatedTrack;
+    if (_followTrack >= 0) {
+        TrackPoint latest = _tracks.track(_followTrack).latest();
+        _center = QPointF(latest.x, latest.y);
+    }
+    update();
+}
+
+QPointF TrackMapWidget::toScreen(const QPointF& world) const
+{
+    return (world - _center) / TrackStore::unitsPerPixel(_zoom) + QPointF(width() / 2.0, height() / 2.0);
+}
@@ -0,0 +1,80 @@
+#ifndef TRACKMAPWIDGET_H
+#define TRACKMAPWIDGET_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "Protocol.h"
+#include "TrackStore.h"
+
+class QPainter;
+
+struct TrackRenderStats {
+    int level = 0;
+    int tracks = 0;    // tracks with something on screen
+    int chunks = 0;    // chunks drawn
+    qint64 points = 0; // points handed to the painter
+};
+
+// Map view with every vehicle's track. The view follows one vehicle, the
+// first one seen until changed. Wheel zooms around the cursor, drag pans,
+// double-click goes back to following, switching to the most recently
+// updated vehicle. The static map image, when there is one, is drawn underneath at
+// its own georeferenced position.
+//
+// Vehicles are told apart by the address and port of their connection until
+// the protocol carries a vehicle id, so a vehicle that reconnects starts a
+// new track, and vehicles behind one NAT never share one.
+class TrackMapWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TrackMapWidget(QWidget *parent = nullptr);
+
+    void addSamples(const QString& vehicle, const QVector<Protocol::TelemetrySample>& samples);
+    const TrackStore& tracks() const;
+    // Vehicle the view follows (and the background is fetched for); empty
+    // before the first sample.
+    QString followedVehicle() const;
+
+    // pixmap covers logicalSize pixels at zoom, centred on latitude/longitude.
+    void setBackground(const QPixmap& pixmap, double latitude, double longitude, double zoom, const QSize& logicalSize);
+    // True when the position is outside the middle half of the background.
+    bool needsBackground(double latitude, double longitude) const;
+
+    // Draws the tracks for a view of size pixels centred on center (world
+    // units). Only chunks of the level picked for zoom that intersect the
+    // view are drawn; fullDetail draws level 0 of everything instead, as a
+    // baseline for the benchmark.
+    static TrackRenderStats paintTracks(QPainter& painter, const TrackStore& store, const QPointF& center,
+                                        double zoom, const QSize& size, bool fullDetail = false);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+
+private:
+    TrackStore _tracks;
+    QPointF _center;
+    double _zoom = 15;
+    bool _follow = true;
+    int _followTrack = -1;
+    int _lastUpdatedTrack = -1;
+    QPixmap _background;
+    QRectF _backgroundWorld;
+    QPoint _dragStart;
+    QPointF _dragCenter;
+
+    QPointF toScreen(const QPointF& world) const;
+
+    static constexpr double MIN_ZOOM = 2;
+    static constexpr double MAX_ZOOM = 21;
+};
+
+#endif // TRACKMAPWIDGET_H
@@ -0,0 +1,203 @@
+#include "TrackStore.h"
+
+#include <QtMath>
+#include <array>
+#include <cmath>
+
+namespace {
+
+inline double distance2(const TrackPoint& a, const TrackPoint& b)
+{
+    double dx = double(a.x) - b.x;
+    double dy = double(a.y) - b.y;
+    return dx * dx + dy * dy;
+}
+
+// Squared distance from points to the segment a-b; the segment is set up once
+// and then tested against every point of an opening window.
+class Segment
+{
+public:
+    Segment(const TrackPoint& a, const TrackPoint& b)
+        : _ax(a.x), _ay(a.y), _dx(double(b.x) - a.x), _dy(double(b.y) - a.y)
+    {
+        double length2 = _dx * _dx + _dy * _dy;
+        _inverseLength2 = length2 > 0 ? 1 / length2 : 0;
+    }
+
+    double distance2(const TrackPoint& p) const
+    {
+        double px = p.x - _ax;
+        double py = p.y - _ay;
+        double t = qBound(0.0, (px * _dx + py * _dy) * _inverseLength2, 1.0);
+        double ex = t * _dx - px;
+        double ey = t * _dy - py;
+        return ex * ex + ey * ey;
+    }
+
+private:
+    double _ax, _ay, _dx, _dy, _inverseLength2;
+};
+
+}
+
+void TrackBounds::extend(const TrackPoint& p)
+{
+    if (isEmpty()) {
+        minX = maxX = p.x;
+        minY = maxY = p.y;
+        return;
+    }
+    minX = qMin(minX, p.x);
+    maxX = qMax(maxX, p.x);
+    minY = qMin(minY, p.y);
+    maxY = qMax(maxY, p.y);
+}
+
+void Track::append(const TrackPoint& p)
+{
+    _latest = p;
+    _bounds.extend(p);
+    ++_count;
+    add(0, p);
+}
+
+void Track::add(int level, const TrackPoint& p)
+{
+    Level& l = _levels[level];
+    if (l.count == 0) {
+        commit(level, p);
+        return;
+    }
+
+    static const auto tolerances2 = []() {
+        std::array<double, LEVELS> squared;
+        for (int i = 0; i < LEVELS; ++i) {
+            squared[i] = TrackStore::tolerance(i) * TrackStore::tolerance(i);
+        }
+        return squared;
+    }();
+    double tolerance2 = tolerances2[level];
+    const TrackPoint& end = l.window.isEmpty() ? l.anchor : l.window.last();
+    if (distance2(end, p) < tolerance2) {
+        return;
+    }
+
+    // Opening window: the segment from the anchor to the newest point must
+    // stay within tolerance of every point in between. When it no longer
+    // does, the previous floating end is kept and becomes the new anchor.
+    l.window.append(p);
+    int n = l.window.size();
+    Segment segment(l.anchor, p);
+    for (int i = 0; i < n - 1; ++i) {
+        if (segment.distance2(l.window[i]) > tolerance2) {
+            TrackPoint keep = l.window[n - 2];
+            l.window.clear();
+            l.window.append(p);
+            commit(level, keep);
+            return;
+        }
+    }
+    // Bounds the per-sample cost on long straight legs.
+    if (n > MAX_WINDOW) {
+        l.window.clear();
+        commit(level, p);
+    }
+}
+
+void Track::commit(int level, const TrackPoint& p)
+{
+    Level& l = _levels[level];
+    if (l.chunks.isEmpty() || l.chunks.last().points.size() >= CHUNK_POINTS) {
+        TrackChunk chunk;
+        chunk.points.reserve(CHUNK_POINTS);
+        if (!l.chunks.isEmpty()) {
+            // Overlap by one point so consecutive chunks draw as one line.
+            TrackPoint previous = l.chunks.last().points.last();
+            chunk.points.append(previous);
+            chunk.bounds.extend(previous);
+        }
+        l.chunks.append(chunk);
+    }
+    TrackChunk& chunk = l.chunks.last();
+    chunk.points.append(p);
+    chunk.bounds.extend(p);
+    l.anchor = p;
+    ++l.count;
+
+    if (level + 1 < LEVELS) {
+        add(level + 1, p);
+    }
+}
+
+int TrackStore::append(const QString& vehicle, double latitude, double longitude)
+{
+    int index = indexOf(vehicle);
+    if (index < 0) {
+        index = addTrack(vehicle);
+    }
+    append(index, latitude, longitude);
+    return index;
+}
+
+void TrackStore::append(int track, double latitude, double longitude)
+{
+    _tracks[track].append(project(latitude, longitude));
+}
+
+int TrackStore::addTrack(const QString& vehicle)
+{
+    _tracks.append(Track());
+    _vehicles.append(vehicle);
+    _index.insert(vehicle, _tracks.size() - 1);
+    return _tracks.size() - 1;
+}
+
+quint64 TrackStore::pointCount(int level) const
+{
+    quint64 count = 0;
+    for (const Track& track : _tracks) {
+        count += level < 0 ? track.sampleCount() : track.pointCount(level);
+    }
+    return count;
+}
+
+TrackPoint TrackStore::project(double latitude, double longitude)
+{
+    double sinLatitude = qBound(-0.9999, std::sin(latitude * M_PI / 180), 0.9999);
+    double x = (longitude + 180) / 360;
+    double y = 0.5 - std::log((1 + sinLatitude) / (1 - sinLatitude)) / (4 * M_PI);
+    TrackPoint p;
+    p.x = qint32(qBound(0.0, x * WORLD_SIZE, double(WORLD_SIZE - 1)));
+    p.y = qint32(qBound(0.0, y * WORLD_SIZE, double(WORLD_SIZE - 1)));
+    return p;
+}
+
+void TrackStore::unproject(double x, double y, double& latitude, double& longitude)
+{
+    longitude = x / WORLD_SIZE * 360 - 180;
+    double n = M_PI - 2 * M_PI * y / WORLD_SIZE;
+    latitude = 180 / M_PI * std::atan(std::sinh(n));
+}
+
+double TrackStore::unitsPerPixel(double zoom)
+{
+    return WORLD_SIZE / (256 * std::exp2(zoom));
+}
+
+double TrackStore::levelZoom(int level)
+{
+    return MAX_DETAIL_ZOOM - 2 * level;
+}
+
+int TrackStore::levelForZoom(double zoom)
+{
+    // Coarsest level whose tolerance is still at most one pixel.
+    int level = int(std::floor((MAX_DETAIL_ZOOM + 1 - zoom) / 2));
+    return qBound(0, level, Track::LEVELS - 1);
+}
+
+double TrackStore::tolerance(int level)
+{
+    return TOLERANCE_PX * unitsPerPixel(levelZoom(level));
+}
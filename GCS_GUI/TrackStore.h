@@ -0,0 +1,119 @@
+#ifndef TRACKSTORE_H
+#define TRACKSTORE_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Vehicle tracks for the map, kept at several levels of detail so that a
+// repaint only touches as many points as the view can show.
+//
+// Positions are projected once, on arrival, to Web Mercator "world" units:
+// the whole map is WORLD_SIZE units across, so one screen pixel at zoom z is
+// WORLD_SIZE / (256 << z) units (1 at zoom 22, about 4 cm at the equator).
+//
+// Each level is a streaming simplification of the one below it: a radial
+// distance filter followed by an opening-window line simplifier (the online
+// counterpart of Douglas-Peucker) with a tolerance of TOLERANCE_PX pixels at
+// the level's zoom. Level 0 takes the raw samples and serves zoom
+// MAX_DETAIL_ZOOM and closer; every further level serves two zoom steps
+// further out. Accepted points are appended to fixed-size chunks with a
+// bounding box, so painting skips whatever is off screen.
+struct TrackPoint {
+    qint32 x = 0;
+    qint32 y = 0;
+};
+
+struct TrackBounds {
+    qint32 minX = 0;
+    qint32 minY = 0;
+    qint32 maxX = -1;
+    qint32 maxY = -1;
+
+    bool isEmpty() const { return maxX < minX; }
+    void extend(const TrackPoint& p);
+    bool intersects(const TrackBounds& other) const
+    {
+        return !isEmpty() && minX <= other.maxX && other.minX <= maxX && minY <= other.maxY && other.minY <= maxY;
+    }
+};
+
+struct TrackChunk {
+    QVector<TrackPoint> points; // starts with the last point of the previous chunk
+    TrackBounds bounds;
+};
+
+class Track
+{
+public:
+    static const int LEVELS = 7;
+
+    void append(const TrackPoint& p);
+
+    bool isEmpty() const { return _count == 0; }
+    quint64 sampleCount() const { return _count; }
+    TrackPoint latest() const { return _latest; }
+    const TrackBounds& bounds() const { return _bounds; }
+
+    // Simplified points of a level. The newest samples are still being
+    // simplified: they run from lastCommitted(level) through pending(level),
+    // then the same for every finer level down to 0, and end at latest().
+    const QVector<TrackChunk>& chunks(int level) const { return _levels[level].chunks; }
+    TrackPoint lastCommitted(int level) const { return _levels[level].anchor; }
+    const QVector<TrackPoint>& pending(int level) const { return _levels[level].window; }
+    quint64 pointCount(int level) const { return _levels[level].count; }
+
+private:
+    struct Level {
+        QVector<TrackChunk> chunks;
+        QVector<TrackPoint> window; // points since the anchor; the last is the floating end
+        TrackPoint anchor;
+        quint64 count = 0;
+    };
+
+    Level _levels[LEVELS];
+    TrackPoint _latest;
+    TrackBounds _bounds;
+    quint64 _count = 0;
+
+    void add(int level, const TrackPoint& p);
+    void commit(int level, const TrackPoint& p);
+
+    static const int CHUNK_POINTS = 256;
+    static const int MAX_WINDOW = 32;
+};
+
+class TrackStore
+{
+public:
+    static const qint32 WORLD_SIZE = 1 << 30;
+    static const int MAX_DETAIL_ZOOM = 19;
+    static constexpr double TOLERANCE_PX = 0.5;
+
+    // Returns the index of the vehicle's track.
+    int append(const QString& vehicle, double latitude, double longitude);
+    void append(int track, double latitude, double longitude);
+    int addTrack(const QString& vehicle);
+
+    int trackCount() const { return _tracks.size(); }
+    const Track& track(int index) const { return _tracks[index]; }
+    QString vehicle(int index) const { return _vehicles[index]; }
+    int indexOf(const QString& vehicle) const { return _index.value(vehicle, -1); }
+    quint64 pointCount(int level) const;
+
+    static TrackPoint project(double latitude, double longitude);
+    static void unproject(double x, double y, double& latitude, double& longitude);
+    static double unitsPerPixel(double zoom);
+    // Zoom a level is simplified for, and the coarsest level good for a zoom.
+    static double levelZoom(int level);
+    static int levelForZoom(double zoom);
+    static double tolerance(int level);
+
+private:
+    QVector<Track> _tracks;
+    QVector<QString> _vehicles;
+    QHash<QString, int> _index;
+};
+
+#endif // TRACKSTORE_H
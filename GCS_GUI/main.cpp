@@ -1,11 +1,81 @@
 #include "mainwindow.h"
+#include "BinaryLog.h"
+#include "Metrics.h"
+#include "MetricsHttpServer.h"
+#include "TrackBenchmark.h"
+#ifdef Q_OS_LINUX
+#include "IngestBenchmark.h"
+#endif
 
 #include <QApplication>
+#include <QDebug>
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QTextStream>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench-tracks") == 0) {
+            // Offline map benchmark: [tracks] [points per track]
+            if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            }
+            QGuiApplication app(argc, argv);
+            int tracks = i + 1 < argc ? QByteArray(argv[i + 1]).toInt() : 1000;
+            int points = i + 2 < argc ? QByteArray(argv[i + 2]).toInt() : 100000;
+            QTextStream out(stdout);
+            return runTrackBenchmark(tracks, points, out);
+        }
+#ifdef Q_OS_LINUX
+        if (std::strcmp(argv[i], "--bench-ingest") == 0) {
+            // Backend scaling benchmark: [connection counts] [seconds] [rate Hz]
+            QCoreApplication app(argc, argv);
+            QList<int> counts;
+            for (const QByteArray& count : QByteArray(i + 1 < argc ? argv[i + 1] : "100,1000,4000").split(',')) {
+                counts.append(count.toInt());
+            }
+            int seconds = i + 2 < argc ? QByteArray(argv[i + 2]).toInt() : 5;
+            int rate = i + 3 < argc ? QByteArray(argv[i + 3]).toInt() : 10;
+            QTextStream out(stdout);
+            return runIngestBenchmark(counts, seconds, rate, out);
+        }
+#endif
+    }
+
+    QString binaryLogPath;
+    QString ingestBackend = "qt";
+    quint16 metricsPort = 9464;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--decode-log") == 0) {
+            // Offline decoder for files written with --binlog
+            QTextStream out(stdout);
+            return BinaryLog::decodeFile(QString::fromLocal8Bit(argv[i + 1]), out) ? 0 : 1;
+        } else if (std::strcmp(argv[i], "--binlog") == 0) {
+            binaryLogPath = QString::fromLocal8Bit(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--log-sample") == 0) {
+            BinaryLog::setSampleInterval(QByteArray(argv[i + 1]).toUInt());
+        } else if (std::strcmp(argv[i], "--metrics-port") == 0) {
+            metricsPort = QByteArray(argv[i + 1]).toUShort();
+        } else if (std::strcmp(argv[i], "--ingest") == 0) {
+            // qt (default) or epoll
+            ingestBackend = QString::fromLocal8Bit(argv[i + 1]);
+        }
+    }
+
     QApplication a(argc, argv);
+    BinaryLog::start(binaryLogPath);
+    MetricsRegistry::instance().setApplication("gcs");
+    MetricsHttpServer metricsServer(metricsPort);
+    if (!IngestServer::backends().contains(ingestBackend)) {
+        qDebug() << "Unknown ingest backend" << ingestBackend << "- available:" << IngestServer::backends();
+        ingestBackend = "qt";
+    }
     MainWindow w;
+    w.setIngestBackend(ingestBackend);
     w.show();
-    return a.exec();
+    int result = a.exec();
+    BinaryLog::stop();
+    return result;
 }
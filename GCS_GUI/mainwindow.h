@@ -2,7 +2,12 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include "MyTCPServer.h"
+#include "IngestServer.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "ImageArchive.h"
+#include "ImageGalleryDialog.h"
+#include "DiagnosticsPanel.h"
 #include <QFile> // Added for QFile
 #include <QGeoCoordinate>
 #include <QTimer>
@@ -21,6 +26,7 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
+    void setIngestBackend(const QString& backend);
 
 private slots:
     void on_btnStartServer_clicked();
@@ -29,7 +35,12 @@ private slots:
     void clientDataReceived(QString message);
     void on_btnSendToAll_clicked();
     void onTelemetryReceived(float latitude, float longitude, float altitude);
+    void onTelemetryBatchReceived(const QVector<Protocol::TelemetrySample>& samples);
+    void onVehicleTelemetryReceived(const QString& vehicle, const QVector<Protocol::TelemetrySample>& samples);
     void onImageReceived(const QImage& image);
+    void onImageDataReceived(const QByteArray& imageData, ImageCodec codec, const QImage& image);
+    void on_btnGallery_clicked();
+    void on_btnDiagnostics_clicked();
     void setupGoogleMap(float latitude, float longitude);
     void resizeEvent(QResizeEvent* event) override;
 
@@ -37,7 +48,11 @@ private slots:
 private:
     Ui::MainWindow *ui;
     QGridLayout *gridLayout;
-    MyTCPServer* _server;
+    IngestServer* _server;
+    QString _ingestBackend;
+    ImageArchive* _archive;
+    ImageGalleryDialog* _gallery;
+    DiagnosticsPanel* _diagnostics;
     QTcpServer *server;
     QTcpSocket *clientSocket;
     QTcpSocket *socket;
@@ -48,6 +63,7 @@ private:
         float altitude;
     } currentPosition, data;
     QGeoCoordinate lastOpenedLocation;
+    bool _mapRequestPending;
 };
 
 #endif // MAINWINDOW_H
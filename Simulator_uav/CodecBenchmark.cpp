@@ -0,0 +1,123 @@
+#include "CodecBenchmark.h"
+#include "ImageCodec.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <cmath>
+
+namespace {
+
+const qint64 MIN_BENCH_NS = 300 * 1000000LL;
+const int MIN_ITERATIONS = 3;
+
+struct Variant {
+    ImageCodec codec;
+    int quality;
+};
+
+const Variant VARIANTS[] = {
+    { ImageCodec::Jpeg, 90 },
+    { ImageCodec::Jpeg, 60 },
+    { ImageCodec::Jpeg, 20 },
+    { ImageCodec::Qoi, -1 },
+    { ImageCodec::Raw, -1 },
+    { ImageCodec::Rgb565, -1 },
+};
+
+const double SCALES[] = { 1.0, 0.5, 0.25 };
+
+// Repeats fn for at least MIN_BENCH_NS and returns the mean time per call.
+template<typename Fn>
+double meanNs(Fn fn)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int iterations = 0;
+    while (iterations < MIN_ITERATIONS || timer.nsecsElapsed() < MIN_BENCH_NS) {
+        fn();
+        ++iterations;
+    }
+    return double(timer.nsecsElapsed()) / iterations;
+}
+
+// Peak signal-to-noise ratio in dB over RGB; infinite for identical images.
+double psnr(const QImage& reference, const QImage& decoded)
+{
+    QImage a = reference.convertToFormat(QImage::Format_RGB888);
+    QImage b = decoded.convertToFormat(QImage::Format_RGB888);
+    if (a.size() != b.size()) {
+        return 0;
+    }
+    double squaredError = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        const uchar* pa = a.constScanLine(y);
+        const uchar* pb = b.constScanLine(y);
+        for (int x = 0; x < a.width() * 3; ++x) {
+            double d = double(pa[x]) - pb[x];
+            squaredError += d * d;
+        }
+    }
+    if (squaredError == 0) {
+        return INFINITY;
+    }
+    double mse = squaredError / (double(a.width()) * a.height() * 3);
+    return 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+}
+
+int runCodecBenchmark(const QStringList& imagePaths, QTextStream& out)
+{
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+               .arg("image", -16).arg("size", 11).arg("codec", -10).arg("bytes", 10)
+               .arg("ratio", 7).arg("enc MB/s", 9).arg("dec MB/s", 9).arg("PSNR dB", 8);
+
+    for (const QString& path : imagePaths) {
+        QImage source(path);
+        if (source.isNull()) {
+            out << "Cannot load " << path << "\n";
+            return 1;
+        }
+        source = source.convertToFormat(QImage::Format_RGB888);
+        QString imageName = QFileInfo(path).fileName();
+
+        for (double scale : SCALES) {
+            QImage image = scale < 1.0
+                ? source.scaled(source.size() * scale, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                : source;
+            // Throughput is measured against the uncompressed RGB888 frame.
+            double rawBytes = double(image.width()) * image.height() * 3;
+            QString size = QString("%1x%2").arg(image.width()).arg(image.height());
+
+            for (const Variant& variant : VARIANTS) {
+                QByteArray encoded;
+                double encodeNs = meanNs([&]() {
+                    encoded = ImageCodecs::encode(image, variant.codec, variant.quality);
+                });
+                QImage decoded;
+                double decodeNs = meanNs([&]() {
+                    decoded = ImageCodecs::decode(encoded, variant.codec);
+                });
+                if (decoded.isNull()) {
+                    out << "Decoding " << ImageCodecs::name(variant.codec) << " failed for " << path << "\n";
+                    return 1;
+                }
+
+                QString codec = ImageCodecs::name(variant.codec);
+                if (variant.quality >= 0) {
+                    codec += QString("@%1").arg(variant.quality);
+                }
+                double quality = psnr(image, decoded);
+                out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                           .arg(imageName, -16).arg(size, 11).arg(codec, -10).arg(encoded.size(), 10)
+                           .arg(rawBytes / encoded.size(), 7, 'f', 2)
+                           .arg(rawBytes / encodeNs * 1000, 9, 'f', 1)
+                           .arg(rawBytes / decodeNs * 1000, 9, 'f', 1)
+                           .arg(std::isinf(quality) ? QString("lossless") : QString::number(quality, 'f', 1), 8);
+                out.flush();
+            }
+        }
+    }
+    return 0;
+}
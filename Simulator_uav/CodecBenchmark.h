@@ -0,0 +1,13 @@
+#ifndef CODECBENCHMARK_H
+#define CODECBENCHMARK_H
+
+#include <QStringList>
+#include <QTextStream>
+
+// Encode/decode throughput, compression ratio and fidelity of every
+// ImageCodec on the given images, at the resolutions the image rate ladder
+// uses. Run with --bench-codecs [image...]; the bundled aerial shot is the
+// default input.
+int runCodecBenchmark(const QStringList& imagePaths, QTextStream& out);
+
+#endif // CODECBENCHMARK_H
@@ -1,13 +1,26 @@
 #include "DeviceController.h"
+#include "BinaryLog.h"
+
+#include <QDateTime>
+#include <QHostAddress>
+#include <QRandomGenerator>
 
 DeviceController::DeviceController(QObject *parent)
     : QObject{parent}
+    , _backlog(MAX_BACKLOG_SAMPLES)
+    , _nextImageId(QRandomGenerator::global()->generate())
 {
     connect(&_socket, &QTcpSocket::connected, this, &DeviceController::connected);
     connect(&_socket, &QTcpSocket::disconnected, this, &DeviceController::disconnected);
     connect(&_socket, &QTcpSocket::errorOccurred, this, &DeviceController::errorOccurred);
     connect(&_socket, &QTcpSocket::stateChanged, this, &DeviceController::socket_stateChanged);
     connect(&_socket, &QTcpSocket::readyRead, this, &DeviceController::socket_readyRead);
+    connect(&_socket, &QTcpSocket::connected, this, &DeviceController::socket_connected);
+
+    _reconnectTimer.setSingleShot(true);
+    connect(&_reconnectTimer, &QTimer::timeout, this, &DeviceController::reconnectTimer_timeout);
+    _throttleTimer.setSingleShot(true);
+    connect(&_throttleTimer, &QTimer::timeout, this, &DeviceController::throttleTimer_timeout);
 }
 
 void DeviceController::connectToDevice(QString ip, int port)
@@ -16,16 +29,30 @@ void DeviceController::connectToDevice(QString ip, int port)
         if (ip == _ip && port == _port) {
             return;
         }
+        _autoReconnect = false;
         _socket.close();
     }
+    if (ip != _ip || port != _port || !_metrics) {
+        if (_metrics) {
+            MetricsRegistry::instance().removeConnection(_metrics);
+        }
+        _metrics = MetricsRegistry::instance().addConnection(QString("%1:%2").arg(ip).arg(port));
+        _wasConnected = false;
+    }
     _ip = ip;
     _port = port;
+    _autoReconnect = true;
+    _reconnectAttempt = 0;
+    _reconnectTimer.stop();
     _socket.connectToHost(_ip, _port);
 
 }
 
 void DeviceController::disconnect()
 {
+    _autoReconnect = false;
+    _reconnectTimer.stop();
+    _backlog.clear();
     _socket.close();
 }
 
@@ -39,16 +66,63 @@ bool DeviceController::isConnected()
     return _socket.state() == QAbstractSocket::ConnectedState;
 }
 
+bool DeviceController::isReconnecting()
+{
+    return _autoReconnect && !isConnected();
+}
+
+int DeviceController::backlogSize() const
+{
+    return _backlog.count();
+}
+
+int DeviceController::pendingImages() const
+{
+    return _images.size();
+}
+
+quint32 DeviceController::peerCodecs() const
+{
+    return _peerCodecs;
+}
+
+bool DeviceController::peerOnLocalNetwork() const
+{
+    QHostAddress address = _socket.peerAddress();
+    if (address.isLoopback() || address.isLinkLocal() || address.isUniqueLocalUnicast()) {
+        return true;
+    }
+    for (const char* subnet : { "10.0.0.0/8", "172.16.0.0/12", "192.168.0.0/16" }) {
+        if (address.isInSubnet(QHostAddress::parseSubnet(subnet))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeviceController::setBandwidthLimit(qint64 bytesPerSecond)
+{
+    _bandwidthLimit = qMax<qint64>(0, bytesPerSecond);
+    _tokens = 0;
+    _throttleClock.start();
+    if (_bandwidthLimit == 0 && !_throttled.isEmpty()) {
+        _socket.write(_throttled);
+        _throttled.clear();
+    }
+}
+
 void DeviceController::send(QString message)
 {
-    _socket.write(message.toUtf8());
+    if (isConnected()) {
+        recordWrite(writeToSocket(message.toUtf8()));
+    }
 }
 
 void DeviceController::send(const QByteArray& data)
 {
     if (_socket.state() == QAbstractSocket::ConnectedState) {
-        qDebug() << "Sending data as QByteArray, size:" << data.size() << ", first few bytes:" << data.left(16).toHex();
-        _socket.write(data);
+        BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::SimSendBytes, data.size(), 0, BinaryLog::prefix(data));
+        recordWrite(writeToSocket(data));
         _socket.flush();
     }
 }
@@ -57,12 +131,13 @@ void DeviceController::send(const QVariant& data)
 {
     if (_socket.state() == QAbstractSocket::ConnectedState) {
         if (data.canConvert<QString>()) {
-            qDebug() << "Sending data as QString:" << data.toString().left(100);
-            _socket.write(data.toString().toUtf8() + "\n");
+            QByteArray text = data.toString().toUtf8() + "\n";
+            BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::SimSendText, text.size());
+            recordWrite(writeToSocket(text));
         } else if (data.canConvert<QByteArray>()) {
             QByteArray byteData = data.toByteArray();
-            qDebug() << "Sending data as QByteArray, size:" << byteData.size() << ", first few bytes:" << byteData.left(16).toHex();
-            _socket.write(byteData);
+            BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::SimSendBytes, byteData.size(), 0, BinaryLog::prefix(byteData));
+            recordWrite(writeToSocket(byteData));
         } else {
             qDebug() << "Unknown data type in send:" << data;
         }
@@ -70,10 +145,60 @@ void DeviceController::send(const QVariant& data)
     }
 }
 
+void DeviceController::sendTelemetry(const Protocol::TelemetrySample& sample)
+{
+    if (isConnected() && _backlog.isEmpty()) {
+        QByteArray line = Protocol::formatTelemetry(sample).toUtf8() + "\n";
+        BLOG_SAMPLED(BinaryLog::Debug, BinaryLog::SimSendText, line.size());
+        recordWrite(writeToSocket(line));
+        return;
+    }
+
+    // Samples are only kept across an unexpected outage; before the first
+    // connect or after disconnect() there is nobody to catch up.
+    if (!_autoReconnect) {
+        return;
+    }
+
+    // Link is down: keep the newest MAX_BACKLOG_SAMPLES for the catch-up batch.
+    if (_backlog.isFull() && _metrics) {
+        _metrics->drops.add();
+    }
+    _backlog.append(sample);
+    if (isConnected()) {
+        flushBacklog();
+    }
+}
+
+void DeviceController::sendImage(const QByteArray& imageData, ImageCodec codec)
+{
+    if (_images.size() >= MAX_QUEUED_IMAGES) {
+        _images.removeFirst();
+        if (_metrics) {
+            _metrics->drops.add();
+        }
+    }
+    ImageTransfer transfer;
+    transfer.id = _nextImageId++;
+    transfer.codec = codec;
+    transfer.data = imageData;
+    transfer.queued.start();
+    _images.append(transfer);
+    if (isConnected()) {
+        sendPendingImages();
+    }
+}
+
 void DeviceController::socket_stateChanged(QAbstractSocket::SocketState state)
 {
     if (state == QAbstractSocket::UnconnectedState) {
         _socket.close();
+        _receiveBuffer.clear();
+        _throttled.clear();
+        _peerCodecs = 0;
+        if (_autoReconnect) {
+            scheduleReconnect();
+        }
     }
     emit stateChanged(state);
 }
@@ -81,5 +206,258 @@ void DeviceController::socket_stateChanged(QAbstractSocket::SocketState state)
 void DeviceController::socket_readyRead()
 {
     auto data = _socket.readAll();
-    emit dataReady(data);
+    if (_metrics) {
+        _metrics->bytesIn.add(data.size());
+        _metrics->framesIn.add();
+    }
+
+    // Everything the GCS sends is a frame; operator text comes as TEXT frames.
+    _receiveBuffer.append(data);
+    qsizetype pos = 0;
+    while (_receiveBuffer.size() - pos >= 4) {
+        const char* p = _receiveBuffer.constData() + pos;
+        qsizetype available = _receiveBuffer.size() - pos;
+        quint32 header = Protocol::readU32(p);
+        qsizetype frameSize = 0;
+        if (header == Protocol::TEXT_HEADER) {
+            if (available < 8) {
+                break;
+            }
+            quint32 size = Protocol::readU32(p + 4);
+            if (size > quint32(Protocol::MAX_FRAME_PAYLOAD)) {
+                qWarning() << "Oversized text frame from the GCS:" << size << "bytes";
+                _socket.abort();
+                return;
+            }
+            frameSize = 8 + qsizetype(size);
+        } else if (header == Protocol::IMAGE_ACK_HEADER) {
+            frameSize = Protocol::IMAGE_ACK_SIZE;
+        } else if (header == Protocol::LINK_FEEDBACK_HEADER) {
+            frameSize = Protocol::LINK_FEEDBACK_SIZE;
+        } else if (header == Protocol::CODEC_OFFER_HEADER) {
+            frameSize = Protocol::CODEC_OFFER_SIZE;
+        } else {
+            // No way to find the next frame boundary; start over on a new connection.
+            qWarning() << "Unknown frame from the GCS, header" << Qt::hex << header;
+            _socket.abort();
+            return;
+        }
+        if (available < frameSize) {
+            break;
+        }
+
+        if (header == Protocol::TEXT_HEADER) {
+            emit dataReady(QByteArray(p + 8, frameSize - 8));
+        } else if (header == Protocol::IMAGE_ACK_HEADER) {
+            handleImageAck(Protocol::readU32(p + 4), Protocol::readU32(p + 8));
+        } else if (header == Protocol::LINK_FEEDBACK_HEADER) {
+            emit linkFeedbackReceived(Protocol::decodeLinkFeedback(p));
+        } else {
+            _peerCodecs = Protocol::readU32(p + 4) | ImageCodecs::mask(ImageCodec::Jpeg);
+            emit codecsOffered(_peerCodecs);
+        }
+        pos += frameSize;
+    }
+    _receiveBuffer.remove(0, pos);
+}
+
+void DeviceController::socket_connected()
+{
+    if (_wasConnected) {
+        MetricsRegistry::instance().reconnects().add();
+    }
+    _wasConnected = true;
+    _reconnectAttempt = 0;
+    _reconnectTimer.stop();
+
+    flushBacklog();
+    for (ImageTransfer& transfer : _images) {
+        if (transfer.acked > 0) {
+            BLOG_INFO(BinaryLog::SimImageResumed, transfer.id, transfer.acked, transfer.data.size());
+        }
+        transfer.sent = transfer.acked;
+        transfer.unackedChunks = 0;
+        transfer.staleAcks = 0;
+    }
+    sendPendingImages();
+}
+
+void DeviceController::reconnectTimer_timeout()
+{
+    if (_autoReconnect && _socket.state() == QAbstractSocket::UnconnectedState) {
+        _socket.connectToHost(_ip, _port);
+    }
+}
+
+void DeviceController::scheduleReconnect()
+{
+    if (_reconnectTimer.isActive()) {
+        return;
+    }
+    // Exponential backoff with "equal jitter": a random delay in [d/2, d].
+    int delay = RECONNECT_BASE_MS << qMin(_reconnectAttempt, 6);
+    delay = qMin(delay, RECONNECT_MAX_MS);
+    delay = delay / 2 + QRandomGenerator::global()->bounded(delay / 2 + 1);
+    ++_reconnectAttempt;
+    BLOG_INFO(BinaryLog::SimReconnectScheduled, _reconnectAttempt, delay);
+    _reconnectTimer.start(delay);
+    emit reconnectScheduled(_reconnectAttempt, delay);
+}
+
+void DeviceController::flushBacklog()
+{
+    if (_backlog.isEmpty() || !isConnected()) {
+        return;
+    }
+
+    // One write per MAX_BATCH_SAMPLES samples instead of one per sample.
+    int samples = _backlog.count();
+    int frames = 0;
+    QVector<Protocol::TelemetrySample> batch;
+    batch.reserve(Protocol::MAX_BATCH_SAMPLES);
+    while (!_backlog.isEmpty()) {
+        batch.clear();
+        while (!_backlog.isEmpty() && batch.size() < Protocol::MAX_BATCH_SAMPLES) {
+            batch.append(_backlog.takeFirst());
+        }
+        recordWrite(writeToSocket(Protocol::encodeTelemetryBatch(batch.constData(), batch.size())));
+        ++frames;
+    }
+    BLOG_INFO(BinaryLog::SimBacklogFlushed, samples, frames);
+    emit backlogFlushed(samples, frames);
+}
+
+void DeviceController::sendPendingImages()
+{
+    quint32 peerCodecs = _peerCodecs | ImageCodecs::mask(ImageCodec::Jpeg);
+    for (int i = 0; i < _images.size(); ++i) {
+        ImageTransfer& transfer = _images[i];
+        if (!(peerCodecs & ImageCodecs::mask(transfer.codec)) && !reencodeAsJpeg(transfer)) {
+            _images.removeAt(i--);
+            if (_metrics) {
+                _metrics->drops.add();
+            }
+            continue;
+        }
+        quint32 size = transfer.data.size();
+        while (transfer.sent < size && isConnected()) {
+            int chunk = qMin<quint32>(IMAGE_CHUNK_SIZE, size - transfer.sent);
+            // JPEG goes out as plain IMAGE_CHUNKs until the GCS has shown it
+            // understands the coded form.
+            QByteArray frame = (_peerCodecs == 0 && transfer.codec == ImageCodec::Jpeg)
+                ? Protocol::encodeImageChunk(transfer.id, transfer.data, transfer.sent, chunk)
+                : Protocol::encodeImageChunk(transfer.id, quint8(transfer.codec), transfer.data, transfer.sent, chunk);
+            qint64 written = writeToSocket(frame);
+            recordWrite(written);
+            if (written < 0) {
+                return;
+            }
+            transfer.sent += chunk;
+            ++transfer.unackedChunks;
+        }
+    }
+}
+
+bool DeviceController::reencodeAsJpeg(ImageTransfer& transfer)
+{
+    // Queued for a GCS that offered this codec, but the one connected now has
+    // not (or not yet). The bytes change, so it restarts as a new transfer.
+    QImage image = ImageCodecs::decode(transfer.data, transfer.codec);
+    QByteArray jpeg = image.isNull() ? QByteArray() : ImageCodecs::encode(image, ImageCodec::Jpeg);
+    if (jpeg.isEmpty()) {
+        return false;
+    }
+    BLOG_INFO(BinaryLog::SimImageReencoded, transfer.id, quint8(transfer.codec), jpeg.size());
+    transfer.id = _nextImageId++;
+    transfer.codec = ImageCodec::Jpeg;
+    transfer.data = jpeg;
+    transfer.acked = 0;
+    transfer.sent = 0;
+    transfer.unackedChunks = 0;
+    transfer.staleAcks = 0;
+    return true;
+}
+
+void DeviceController::handleImageAck(quint32 imageId, quint32 receivedOffset)
+{
+    for (int i = 0; i < _images.size(); ++i) {
+        ImageTransfer& transfer = _images[i];
+        if (transfer.id != imageId) {
+            continue;
+        }
+        receivedOffset = qMin<quint32>(receivedOffset, transfer.data.size());
+        if (transfer.unackedChunks > 0) {
+            --transfer.unackedChunks;
+        }
+        // Every chunk the GCS takes moves its ack forward. One that does not
+        // was ignored because the GCS no longer holds the bytes before it
+        // (e.g. it evicted its partial copy, possibly before acking anything);
+        // resend from what it still holds. The chunks already in flight will
+        // be ignored the same way, so their acks do not trigger another resend.
+        if (transfer.staleAcks > 0) {
+            --transfer.staleAcks;
+        } else if (receivedOffset <= transfer.acked && receivedOffset < transfer.sent) {
+            transfer.acked = receivedOffset;
+            transfer.sent = receivedOffset;
+            transfer.staleAcks = transfer.unackedChunks;
+            sendPendingImages();
+            return;
+        }
+        if (receivedOffset <= transfer.acked) {
+            return;
+        }
+        transfer.acked = receivedOffset;
+        if (transfer.acked == quint32(transfer.data.size())) {
+            qint64 latencyMs = transfer.queued.elapsed();
+            int bytes = transfer.data.size();
+            _images.removeAt(i);
+            emit imageDelivered(imageId, latencyMs, bytes);
+        }
+        return;
+    }
+}
+
+void DeviceController::recordWrite(qint64 bytes)
+{
+    if (!_metrics) {
+        return;
+    }
+    if (bytes < 0) {
+        _metrics->drops.add();
+        return;
+    }
+    _metrics->bytesOut.add(bytes);
+    _metrics->framesOut.add();
+    _metrics->bufferedBytes.set(_socket.bytesToWrite() + _throttled.size());
+}
+
+qint64 DeviceController::writeToSocket(const QByteArray& data)
+{
+    if (_bandwidthLimit <= 0) {
+        return _socket.write(data);
+    }
+    // Like QTcpSocket::write(), refuse data while there is no connection;
+    // whatever is queued is dropped when the connection goes away.
+    if (!isConnected()) {
+        return -1;
+    }
+    _throttled.append(data);
+    throttleTimer_timeout();
+    return data.size();
+}
+
+void DeviceController::throttleTimer_timeout()
+{
+    // Token bucket with a burst of 1/20 s worth of bytes.
+    double burst = qMax(1024.0, _bandwidthLimit / 20.0);
+    _tokens = qMin(burst, _tokens + _bandwidthLimit * (_throttleClock.restart() / 1000.0));
+    qint64 n = qMin<qint64>(qint64(_tokens), _throttled.size());
+    if (n > 0 && isConnected()) {
+        _socket.write(_throttled.constData(), n);
+        _throttled.remove(0, n);
+        _tokens -= n;
+    }
+    if (!_throttled.isEmpty() && !_throttleTimer.isActive()) {
+        _throttleTimer.start(10);
+    }
 }
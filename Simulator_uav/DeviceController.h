@@ -7,6 +7,13 @@
 #include <QByteArray>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QTimer>
+#include <QContiguousCache>
+#include <QElapsedTimer>
+#include <memory>
+#include "ImageCodec.h"
+#include "Metrics.h"
+#include "Protocol.h"
 
 class DeviceController : public QObject
 {
@@ -16,9 +23,20 @@ public:
     void connectToDevice(QString ip, int port);
     void disconnect();
     bool isConnected();
+    bool isReconnecting();
     void send(QString message);
     void send(const QVariant& data);
     void send(const QByteArray& data);
+    void sendTelemetry(const Protocol::TelemetrySample& sample);
+    void sendImage(const QByteArray& imageData, ImageCodec codec = ImageCodec::Jpeg);
+    int backlogSize() const;
+    int pendingImages() const;
+    // Synthetic link limit for testing rate control; 0 disables it.
+    void setBandwidthLimit(qint64 bytesPerSecond);
+    // ImageCodec mask from the GCS's CODEC_OFFER; 0 until one arrives, in
+    // which case only JPEG may be sent.
+    quint32 peerCodecs() const;
+    bool peerOnLocalNetwork() const;
     QTcpSocket* socket;
     QAbstractSocket::SocketState state();
 
@@ -28,15 +46,65 @@ signals:
     void stateChanged(QAbstractSocket::SocketState);
     void errorOccurred(QAbstractSocket::SocketError);
     void dataReady(QByteArray data);
+    void reconnectScheduled(int attempt, int delayMs);
+    void backlogFlushed(int samples, int frames);
+    void imageDelivered(quint32 imageId, qint64 latencyMs, int bytes);
+    void linkFeedbackReceived(const Protocol::LinkFeedback& feedback);
+    void codecsOffered(quint32 codecMask);
 
 private slots:
     void socket_stateChanged(QAbstractSocket::SocketState state);
     void socket_readyRead();
+    void socket_connected();
+    void reconnectTimer_timeout();
+    void throttleTimer_timeout();
 
 private:
+    // An image is sent as IMAGE_CHUNK frames. The GCS acknowledges the bytes
+    // it holds; after a reconnect sending restarts at the acknowledged offset.
+    struct ImageTransfer {
+        quint32 id;
+        ImageCodec codec;
+        QByteArray data;
+        quint32 acked = 0;
+        quint32 sent = 0;
+        int unackedChunks = 0;  // chunks sent on this connection, ack not yet seen
+        int staleAcks = 0;      // acks still due for chunks sent before a resend
+        QElapsedTimer queued;
+    };
+
     QTcpSocket _socket;
     QString _ip;
     int _port;
+    bool _wasConnected = false;
+    bool _autoReconnect = false;
+    int _reconnectAttempt = 0;
+    quint32 _peerCodecs = 0;
+    QTimer _reconnectTimer;
+    QContiguousCache<Protocol::TelemetrySample> _backlog;
+    QList<ImageTransfer> _images;
+    quint32 _nextImageId;
+    QByteArray _receiveBuffer;
+    std::shared_ptr<ConnectionMetrics> _metrics;
+    qint64 _bandwidthLimit = 0;
+    QByteArray _throttled;
+    double _tokens = 0;
+    QTimer _throttleTimer;
+    QElapsedTimer _throttleClock;
+
+    void recordWrite(qint64 bytes);
+    qint64 writeToSocket(const QByteArray& data);
+    void scheduleReconnect();
+    void flushBacklog();
+    void sendPendingImages();
+    bool reencodeAsJpeg(ImageTransfer& transfer);
+    void handleImageAck(quint32 imageId, quint32 receivedOffset);
+
+    static constexpr int MAX_BACKLOG_SAMPLES = 4096;
+    static constexpr int MAX_QUEUED_IMAGES = 4;
+    static constexpr int IMAGE_CHUNK_SIZE = 16 * 1024;
+    static constexpr int RECONNECT_BASE_MS = 500;
+    static constexpr int RECONNECT_MAX_MS = 30000;
 };
 
 #endif // DEVICECONTROLLER_H
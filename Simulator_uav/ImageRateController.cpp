@@ -0,0 +1,148 @@
+#include "ImageRateController.h"
+#include "BinaryLog.h"
+#include "Metrics.h"
+
+namespace {
+
+const ImageRateController::Settings LADDER[] = {
+    { 90, 1.00, 500 },
+    { 75, 1.00, 500 },
+    { 60, 1.00, 500 },
+    { 60, 0.75, 500 },
+    { 50, 0.75, 750 },
+    { 50, 0.50, 1000 },
+    { 40, 0.50, 1500 },
+    { 30, 0.35, 2000 },
+    { 25, 0.25, 3000 },
+    { 20, 0.25, 5000 },
+};
+const int LEVELS = sizeof(LADDER) / sizeof(LADDER[0]);
+
+}
+
+ImageRateController::ImageRateController(QObject *parent)
+    : QObject(parent)
+    , _levelGauge(MetricsRegistry::instance().gauge("image_rate_level"))
+    , _qualityGauge(MetricsRegistry::instance().gauge("image_jpeg_quality"))
+    , _scaleGauge(MetricsRegistry::instance().gauge("image_scale_percent"))
+    , _intervalGauge(MetricsRegistry::instance().gauge("image_interval_ms"))
+    , _latencyGauge(MetricsRegistry::instance().gauge("image_delivery_latency_ms"))
+{
+    setLevel(0, "initial");
+}
+
+ImageRateController::Settings ImageRateController::settings() const
+{
+    return LADDER[_level];
+}
+
+int ImageRateController::level() const
+{
+    return _level;
+}
+
+void ImageRateController::setTargetLatency(int ms)
+{
+    _targetLatencyMs = qMax(1, ms);
+}
+
+int ImageRateController::targetLatency() const
+{
+    return _targetLatencyMs;
+}
+
+void ImageRateController::imageDelivered(qint64 latencyMs, int bytes)
+{
+    _latencySumMs += latencyMs;
+    ++_latencyCount;
+    _imageBytesSum += bytes;
+    ++_imageCount;
+    _latencyGauge.set(latencyMs);
+}
+
+void ImageRateController::feedbackReceived(const Protocol::LinkFeedback& feedback, int imagesInFlight)
+{
+    bool delivered = _latencyCount > 0;
+    qint64 latencyMs = delivered ? _latencySumMs / _latencyCount : 0;
+    _latencySumMs = 0;
+    _latencyCount = 0;
+    quint32 newDrops = feedback.droppedImages - qMin(_lastDropped, feedback.droppedImages);
+    _lastDropped = feedback.droppedImages;
+    _rxBytesSum += feedback.rxBytesPerSecond;
+    ++_rxReports;
+    // The GCS acks chunks as they arrive, so its decode time comes on top.
+    qint64 totalLatencyMs = latencyMs + feedback.decodeLatencyMs;
+
+    // Latency is only measured on delivery, so a stalled link shows up here
+    // as images piling up in flight, not as high latency.
+    QString reason;
+    if (newDrops > 0) {
+        reason = QString("GCS dropped %1 images").arg(newDrops);
+    } else if (feedback.decodeQueueDepth > 1) {
+        reason = QString("GCS decode queue %1").arg(feedback.decodeQueueDepth);
+    } else if (totalLatencyMs > _targetLatencyMs) {
+        reason = QString("latency %1 ms + decode %2 ms > %3 ms")
+                     .arg(latencyMs).arg(feedback.decodeLatencyMs).arg(_targetLatencyMs);
+    } else if (imagesInFlight > 1) {
+        reason = QString("%1 images in flight").arg(imagesInFlight);
+    }
+
+    if (!reason.isEmpty()) {
+        _healthyReports = 0;
+        _holdReports = HOLD_REPORTS_AFTER_STEP_DOWN;
+        if (_level < LEVELS - 1) {
+            setLevel(qMin(LEVELS - 1, _level + 2), reason);
+        }
+        return;
+    }
+
+    if (_holdReports > 0) {
+        --_holdReports;
+        return;
+    }
+    // Only step up when there is clear headroom, not just "not congested". A
+    // period without any delivery says nothing about headroom; it neither
+    // counts towards stepping up nor resets the run, since at the slower
+    // levels images are further apart than the feedback interval.
+    if (!delivered || totalLatencyMs > _targetLatencyMs / 2) {
+        return;
+    }
+    // Reports come about once a second, so their mean is the rate the GCS
+    // actually received at this level. Falling short of what the level sends
+    // means bytes are queueing somewhere even if latency does not show it
+    // yet; 10% slack covers the two averages not covering the same time.
+    qint64 rxBytesPerSecond = _rxBytesSum / _rxReports;
+    qint64 levelRate = levelBytesPerSecond();
+    if (rxBytesPerSecond < levelRate * 9 / 10) {
+        return;
+    }
+    if (++_healthyReports >= HEALTHY_REPORTS_TO_STEP_UP && _level > 0) {
+        _healthyReports = 0;
+        setLevel(_level - 1, QString("headroom: latency %1 ms + decode %2 ms, %3 of %4 B/s received")
+                                 .arg(latencyMs).arg(feedback.decodeLatencyMs).arg(rxBytesPerSecond).arg(levelRate));
+    }
+}
+
+void ImageRateController::setLevel(int level, const QString& reason)
+{
+    _level = level;
+    _imageBytesSum = 0;
+    _imageCount = 0;
+    _rxBytesSum = 0;
+    _rxReports = 0;
+    const Settings& current = LADDER[_level];
+    _levelGauge.set(_level);
+    _qualityGauge.set(current.quality);
+    _scaleGauge.set(qRound(current.scale * 100));
+    _intervalGauge.set(current.intervalMs);
+    BLOG_INFO(BinaryLog::SimRateDecision, _level, current.quality, current.intervalMs);
+    emit settingsChanged(current, reason);
+}
+
+qint64 ImageRateController::levelBytesPerSecond() const
+{
+    if (_imageCount == 0) {
+        return 0;
+    }
+    return _imageBytesSum / _imageCount * 1000 / LADDER[_level].intervalMs;
+}
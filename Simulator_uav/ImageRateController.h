@@ -0,0 +1,68 @@
+#ifndef IMAGERATECONTROLLER_H
+#define IMAGERATECONTROLLER_H
+
+#include <QObject>
+#include <QString>
+#include "Protocol.h"
+
+class Gauge;
+
+// Picks JPEG quality, resolution and frame interval for the image stream from
+// the GCS link feedback and the measured delivery latency.
+//
+// The settings form a ladder from best (level 0) to cheapest. Congestion moves
+// two levels down at once, a run of healthy reports moves one level up: an
+// AIMD-style loop that settles just below what the link and the GCS decoder
+// can sustain. Latency counts from queueing an image to its final ack plus
+// the GCS's decode time; a step up also needs the GCS to be receiving the
+// bytes per second the current level sends.
+class ImageRateController : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Settings {
+        int quality;    // JPEG quality, 0-100
+        double scale;   // fraction of the source resolution
+        int intervalMs; // time between images
+    };
+
+    explicit ImageRateController(QObject *parent = nullptr);
+
+    Settings settings() const;
+    int level() const;
+    void setTargetLatency(int ms);
+    int targetLatency() const;
+
+    void imageDelivered(qint64 latencyMs, int bytes);
+    void feedbackReceived(const Protocol::LinkFeedback& feedback, int imagesInFlight);
+
+signals:
+    void settingsChanged(const ImageRateController::Settings& settings, const QString& reason);
+
+private:
+    int _level = 0;
+    int _targetLatencyMs = 1000;
+    int _healthyReports = 0;
+    int _holdReports = 0;
+    quint32 _lastDropped = 0;
+    qint64 _latencySumMs = 0;
+    int _latencyCount = 0;
+    qint64 _imageBytesSum = 0;  // delivered since the level changed
+    int _imageCount = 0;
+    qint64 _rxBytesSum = 0;     // reported since the level changed
+    int _rxReports = 0;
+    Gauge& _levelGauge;
+    Gauge& _qualityGauge;
+    Gauge& _scaleGauge;
+    Gauge& _intervalGauge;
+    Gauge& _latencyGauge;
+
+    void setLevel(int level, const QString& reason);
+    qint64 levelBytesPerSecond() const;
+
+    static const int HEALTHY_REPORTS_TO_STEP_UP = 3;
+    static const int HOLD_REPORTS_AFTER_STEP_DOWN = 2;
+};
+
+#endif // IMAGERATECONTROLLER_H
@@ -9,14 +9,20 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    CodecBenchmark.cpp \
     DeviceController.cpp \
+    ImageRateController.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
+    CodecBenchmark.h \
     DeviceController.h \
+    ImageRateController.h \
     mainwindow.h
 
+include(../common/common.pri)
+
 FORMS += \
     mainwindow.ui
 
@@ -1,11 +1,65 @@
 #include "mainwindow.h"
+#include "BinaryLog.h"
+#include "CodecBenchmark.h"
+#include "Metrics.h"
+#include "MetricsHttpServer.h"
 
 #include <QApplication>
+#include <QDebug>
+#include <QTextStream>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench-codecs") == 0) {
+            // Offline benchmark; any further arguments are images to use.
+            QCoreApplication app(argc, argv);
+            QStringList paths;
+            for (int j = i + 1; j < argc; ++j) {
+                paths << QString::fromLocal8Bit(argv[j]);
+            }
+            if (paths.isEmpty()) {
+                paths << ":/images/Agri.jpeg";
+            }
+            QTextStream out(stdout);
+            return runCodecBenchmark(paths, out);
+        }
+    }
+
+    QString binaryLogPath;
+    QString imageCodec = "auto";
+    quint16 metricsPort = 9465;
+    qint64 bandwidthLimit = 0;
+    int targetLatencyMs = 1000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--binlog") == 0) {
+            binaryLogPath = QString::fromLocal8Bit(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--log-sample") == 0) {
+            BinaryLog::setSampleInterval(QByteArray(argv[i + 1]).toUInt());
+        } else if (std::strcmp(argv[i], "--metrics-port") == 0) {
+            metricsPort = QByteArray(argv[i + 1]).toUShort();
+        } else if (std::strcmp(argv[i], "--bandwidth-limit") == 0) {
+            bandwidthLimit = QByteArray(argv[i + 1]).toLongLong();
+        } else if (std::strcmp(argv[i], "--target-latency") == 0) {
+            targetLatencyMs = QByteArray(argv[i + 1]).toInt();
+        } else if (std::strcmp(argv[i], "--image-codec") == 0) {
+            imageCodec = QString::fromLocal8Bit(argv[i + 1]);
+        }
+    }
+
     QApplication a(argc, argv);
+    BinaryLog::start(binaryLogPath);
+    MetricsRegistry::instance().setApplication("simulator");
+    MetricsHttpServer metricsServer(metricsPort);
     MainWindow w;
+    w.setBandwidthLimit(bandwidthLimit);
+    w.setTargetLatency(targetLatencyMs);
+    if (!w.setImageCodec(imageCodec)) {
+        qDebug() << "Unknown image codec" << imageCodec << "- choosing automatically";
+    }
     w.show();
-    return a.exec();
+    int result = a.exec();
+    BinaryLog::stop();
+    return result;
 }
@@ -1,6 +1,8 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "devicecontroller.h"
+#include "BinaryLog.h"
+#include "Metrics.h"
 
 #include <QMetaEnum>
 #include <QMessageBox>
@@ -11,6 +13,7 @@
 #include <QtNetwork/QTcpSocket>
 #include <QTimer>
 #include <QString>
+#include <QStringList>
 #include <cstdlib>
 #include <ctime>
 #include <QDebug>
@@ -20,6 +23,7 @@
 #include <QThread>
 #include <QCoreApplication>
 #include <QDataStream>
+#include <QDateTime>
 
 
 
@@ -28,6 +32,7 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    _diagnostics = nullptr;
     setDeviceContoller();
     std::srand(static_cast<unsigned>(std::time(nullptr)));
 
@@ -63,7 +68,7 @@ void MainWindow::on_lnIPAddress_textChanged(const QString &arg1)
 
 void MainWindow::on_btnConnect_clicked()
 {
-    if (_controller.isConnected()) {
+    if (_controller.isConnected() || _controller.isReconnecting()) {
         _controller.disconnect();
     } else {
         auto ip = ui->lnIPAddress->text();
@@ -82,7 +87,7 @@ void MainWindow::device_connected()
 void MainWindow::device_disconnected()
 {
     ui->lstConsole->addItem("Disconnected from Device");
-    ui->btnConnect->setText("Connect");
+    ui->btnConnect->setText(_controller.isReconnecting() ? "Stop Reconnecting" : "Connect");
     ui->grpSendData->setEnabled(false);
 }
 
@@ -104,6 +109,29 @@ void MainWindow::device_dataReady(QByteArray data)
     ui->lstConsole->addItem(QString(data));
 }
 
+void MainWindow::device_reconnectScheduled(int attempt, int delayMs)
+{
+    ui->lstConsole->addItem(QString("Reconnect attempt %1 in %2 ms, %3 samples buffered")
+                                .arg(attempt).arg(delayMs).arg(_controller.backlogSize()));
+    ui->btnConnect->setText("Stop Reconnecting");
+}
+
+void MainWindow::device_backlogFlushed(int samples, int frames)
+{
+    ui->lstConsole->addItem(QString("Sent %1 buffered samples in %2 frames").arg(samples).arg(frames));
+}
+
+void MainWindow::device_codecsOffered(quint32 codecMask)
+{
+    QStringList names;
+    for (int i = 0; i < int(ImageCodec::Count); ++i) {
+        if (codecMask & ImageCodecs::mask(ImageCodec(i))) {
+            names << ImageCodecs::name(ImageCodec(i));
+        }
+    }
+    ui->lstConsole->addItem(QString("GCS decodes: %1").arg(names.join(", ")));
+}
+
 void MainWindow::setDeviceContoller()
 {
     connect(&_controller, &DeviceController::connected, this, &MainWindow::device_connected);
@@ -111,64 +139,134 @@ void MainWindow::setDeviceContoller()
     connect(&_controller, &DeviceController::stateChanged, this, &MainWindow::device_stateChanged);
     connect(&_controller, &DeviceController::errorOccurred, this, &MainWindow::device_errorOccurred);
     connect(&_controller, &DeviceController::dataReady, this, &MainWindow::device_dataReady);
+    connect(&_controller, &DeviceController::reconnectScheduled, this, &MainWindow::device_reconnectScheduled);
+    connect(&_controller, &DeviceController::backlogFlushed, this, &MainWindow::device_backlogFlushed);
+    connect(&_controller, &DeviceController::codecsOffered, this, &MainWindow::device_codecsOffered);
+    connect(&_controller, &DeviceController::imageDelivered, this, [this](quint32, qint64 latencyMs, int bytes) {
+        _rateController.imageDelivered(latencyMs, bytes);
+    });
+    connect(&_controller, &DeviceController::linkFeedbackReceived, this, [this](const Protocol::LinkFeedback& feedback) {
+        _rateController.feedbackReceived(feedback, _controller.pendingImages());
+    });
+    connect(&_rateController, &ImageRateController::settingsChanged, this, &MainWindow::rateController_settingsChanged);
+    connect(&imageTimer, &QTimer::timeout, this, &MainWindow::sendImageFrame);
 }
 
 
 void MainWindow::on_btnSend_clicked()
 {
     auto message = ui->lnMessage->text().trimmed();
-    QByteArray packet;
-    QDataStream out(&packet, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_5_15);
-
-    // Different header for text, ex. 0xB1B2B3B4
-    quint32 headerValue = 0xB1B2B3B4;
-    out << headerValue;
-    out << qint32(message.size());
-    packet.append(message.toUtf8());
+    QByteArray packet = Protocol::encodeTextFrame(message);
 
-    qDebug() << "Client sending text message, total packet size:" << packet.size();
+    BLOG_DEBUG(BinaryLog::SimTextSent, packet.size());
     _controller.send(packet);
 }
 
 void MainWindow::on_sendImageButton_clicked()
 {
-    QImage image(":/images/Agri.jpeg");
-    if (image.isNull()) {
-        ui->lstConsole->addItem("Failed to load image: Agri.jpeg");
-        qDebug() << "Failed to load image.";
+    if (imageTimer.isActive()) {
+        imageTimer.stop();
+        ui->lstConsole->addItem("Image stream stopped.");
         return;
     }
+    imageTimer.start(_rateController.settings().intervalMs);
+    ui->lstConsole->addItem("Image stream started.");
+    sendImageFrame();
+}
 
-    // Convert QImage to QByteArray explicitly
+void MainWindow::sendImageFrame()
+{
+    if (_sourceImage.isNull()) {
+        _sourceImage = QImage(":/images/Agri.jpeg");
+        if (_sourceImage.isNull()) {
+            ui->lstConsole->addItem("Failed to load image: Agri.jpeg");
+            qDebug() << "Failed to load image.";
+            imageTimer.stop();
+            return;
+        }
+    }
+
+    // Skip a frame rather than queue images the link has not caught up with.
+    if (_controller.pendingImages() >= 2) {
+        return;
+    }
+
+    ImageRateController::Settings settings = _rateController.settings();
+    QImage image = _sourceImage;
+    if (settings.scale < 1.0) {
+        image = _sourceImage.scaled(_sourceImage.size() * settings.scale, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    ImageCodec codec = chooseCodec();
     QByteArray imageData;
-    QBuffer buffer(&imageData);
-    buffer.open(QIODevice::WriteOnly);
-    image.save(&buffer, "JPEG");
-    buffer.close();
-
-    // Create packet with header and size
-    QByteArray packet;
-    QDataStream out(&packet, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_5_15); // Ensure consistent version
-    quint32 headerValue = 0xA1B2C3D4;
-    out << headerValue; // Write header
-    out << qint32(imageData.size()); // Write size of image data
-    packet.append(imageData); // Append the image data directly
-
-    qDebug() << "Client sending image, total packet size:" << packet.size();
-    qDebug() << "Header should be a1b2c3d4, actual:" << QByteArray((const char*)&headerValue, sizeof(quint32)).toHex();
-    qDebug() << "First few bytes of packet:" << packet.left(16).toHex();
-    qDebug() << "Image data size:" << imageData.size();
-
-    // Send the serialized data
-    _controller.send(packet);
+    {
+        ScopedTiming encodeTiming(MetricsRegistry::instance().stage(Stage::ImageEncode).duration);
+        imageData = ImageCodecs::encode(image, codec, settings.quality);
+    }
+
+    // Sent as acknowledged chunks; queued while the link is down and resumed
+    // from the last acknowledged offset after a reconnect.
+    BLOG_INFO(BinaryLog::SimCodedImageSent, imageData.size(), quint8(codec));
+    _controller.sendImage(imageData, codec);
+}
 
-    // Ensure socket flushes
-    QCoreApplication::processEvents();
-    QThread::msleep(50);
+ImageCodec MainWindow::chooseCodec()
+{
+    // Only what the GCS offered; JPEG is always understood.
+    quint32 offered = _controller.peerCodecs();
+    ImageCodec codec = ImageCodec::Jpeg;
+    if (!_autoCodec) {
+        if (offered & ImageCodecs::mask(_imageCodec)) {
+            codec = _imageCodec;
+        }
+    } else if ((offered & ImageCodecs::mask(ImageCodec::Qoi)) && _controller.peerOnLocalNetwork()
+               && _rateController.level() == 0) {
+        // Lossless while a local link keeps up at full quality; once the rate
+        // controller has to step down, JPEG is the cheaper way to shed bytes.
+        codec = ImageCodec::Qoi;
+    }
 
-    ui->lstConsole->addItem("Image sent to server.");
+    if (codec != _lastCodec) {
+        _lastCodec = codec;
+        ui->lstConsole->addItem(QString("Image codec: %1").arg(ImageCodecs::name(codec)));
+    }
+    return codec;
+}
+
+bool MainWindow::setImageCodec(const QString& name)
+{
+    if (name.compare("auto", Qt::CaseInsensitive) == 0) {
+        _autoCodec = true;
+        return true;
+    }
+    if (!ImageCodecs::fromName(name, _imageCodec)) {
+        return false;
+    }
+    _autoCodec = false;
+    return true;
+}
+
+void MainWindow::rateController_settingsChanged(const ImageRateController::Settings& settings, const QString& reason)
+{
+    ui->lstConsole->addItem(QString("Image rate: quality %1, scale %2%, every %3 ms (%4)")
+                                .arg(settings.quality).arg(qRound(settings.scale * 100))
+                                .arg(settings.intervalMs).arg(reason));
+    if (imageTimer.isActive()) {
+        imageTimer.setInterval(settings.intervalMs);
+    }
+}
+
+void MainWindow::setBandwidthLimit(qint64 bytesPerSecond)
+{
+    _controller.setBandwidthLimit(bytesPerSecond);
+    if (bytesPerSecond > 0) {
+        ui->lstConsole->addItem(QString("Synthetic bandwidth limit: %1 B/s").arg(bytesPerSecond));
+    }
+}
+
+void MainWindow::setTargetLatency(int ms)
+{
+    _rateController.setTargetLatency(ms);
 }
 void MainWindow::sendTelemetryData()
 {
@@ -177,19 +275,30 @@ void MainWindow::sendTelemetryData()
     currentPosition.longitude += ((std::rand() % 100) - 50) * 0.0001;
     currentPosition.altitude += ((std::rand() % 20) - 10) * 0.1;
 
-    QString telemetry = QString("Latitude: %1, Longitude: %2, Altitude: %3")
-                            .arg(currentPosition.latitude, 0, 'f', 6)
-                            .arg(currentPosition.longitude, 0, 'f', 6)
-                            .arg(currentPosition.altitude, 0, 'f', 2);
+    Protocol::TelemetrySample sample;
+    sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+    sample.latitude = currentPosition.latitude;
+    sample.longitude = currentPosition.longitude;
+    sample.altitude = currentPosition.altitude;
 
     ui->latLabel->setText(QString("Latitude: %1").arg(currentPosition.latitude, 0, 'f', 6));
     ui->lonLabel->setText(QString("Longitude: %1").arg(currentPosition.longitude, 0, 'f', 6));
     ui->altLabel->setText(QString("Altitude: %1").arg(currentPosition.altitude, 0, 'f', 2));
 
-    _controller.send(telemetry);
+    // Buffered by the controller while the link is down
+    _controller.sendTelemetry(sample);
 }
 
 
+void MainWindow::on_btnDiagnostics_clicked()
+{
+    if (_diagnostics == nullptr) {
+        _diagnostics = new DiagnosticsPanel(this);
+    }
+    _diagnostics->show();
+    _diagnostics->raise();
+}
+
 void MainWindow::on_sendTelemetryButton_clicked()
 {
     if (telemetryTimer->isActive()) {
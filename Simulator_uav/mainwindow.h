@@ -5,8 +5,9 @@
 #include <QStyle>
 #include <QHostAddress>
 #include "DeviceController.h"
+#include "DiagnosticsPanel.h"
+#include "ImageRateController.h"
 #include <QTimer>
-#include <QTcpServer>
 #include <QTcpSocket>
 
 
@@ -27,8 +28,11 @@ class MainWindow : public QMainWindow
 
 public:
     MainWindow(QWidget *parent = nullptr);
-    MainWindow(Ui::MainWindow *ui, const DeviceController &controller, QTcpSocket *socket, const QTimer &telemetryTimer, const QTimer &imageTimer, const Telemetry &currentPosition);
     ~MainWindow();
+    void setBandwidthLimit(qint64 bytesPerSecond);
+    void setTargetLatency(int ms);
+    // "auto" or an ImageCodec name; returns false for an unknown name.
+    bool setImageCodec(const QString& name);
 
 private slots:
     void on_lnIPAddress_textChanged(const QString &arg1);
@@ -38,28 +42,37 @@ private slots:
     void device_stateChanged(QAbstractSocket::SocketState);
     void device_errorOccurred(QAbstractSocket::SocketError);
     void device_dataReady(QByteArray data);
+    void device_reconnectScheduled(int attempt, int delayMs);
+    void device_backlogFlushed(int samples, int frames);
+    void device_codecsOffered(quint32 codecMask);
     void on_btnSend_clicked();
     // void sendTelemetryAndImage();
 
     void on_sendImageButton_clicked();
+    void sendImageFrame();
+    void rateController_settingsChanged(const ImageRateController::Settings& settings, const QString& reason);
 
     void on_sendTelemetryButton_clicked();
     void sendTelemetryData();
+    void on_btnDiagnostics_clicked();
 
 
 private:
     Ui::MainWindow *ui;
     DeviceController _controller;
 
-    QTcpSocket *socket;
-    QTcpServer server;
-
     QTimer imageTimer;
+    QImage _sourceImage;
+    ImageRateController _rateController;
+    bool _autoCodec = true;
+    ImageCodec _imageCodec = ImageCodec::Jpeg;
+    ImageCodec _lastCodec = ImageCodec::Jpeg;
     QTimer* telemetryTimer;
     Telemetry currentPosition;
-    QList<QTcpSocket*> _socketsList;
+    DiagnosticsPanel* _diagnostics;
 
     //methods
     void setDeviceContoller();
+    ImageCodec chooseCodec();
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,298 @@
+#include "BinaryLog.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace BinaryLog {
+
+namespace {
+
+const quint32 FILE_MAGIC = 0x474F4C42; // "BLOG"
+const quint32 FILE_VERSION = 1;
+
+// Log files are written in host byte order; they are decoded on the machine
+// (or at least the architecture) that produced them.
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    qint64 wallClockMs;
+    quint64 steadyNs;
+};
+
+struct EventInfo {
+    const char* name;
+    const char* format;
+};
+
+// Placeholders: {a} {b} {c} print unsigned decimal, :x hex, :f the low 32 bits
+// as a float.
+const EventInfo EVENTS[EventCount] = {
+    { "GcsBufferReceived", "received {a} bytes on socket {b}, head {c:x}" },
+    { "GcsTelemetryParsed", "telemetry lat={a:f} lon={b:f} alt={c:f}" },
+    { "GcsImageChunk", "image data buffered, {a} bytes on socket {b}" },
+    { "GcsImageWaiting", "image incomplete, need {a} bytes, have {b}" },
+    { "GcsImageDecoded", "image decoded {a}x{b}, {c} bytes" },
+    { "GcsImageDecodeFailed", "image decode failed, {a} bytes, head {c:x}" },
+    { "SimSendBytes", "sent {a} bytes, head {c:x}" },
+    { "SimSendText", "sent text, {a} bytes" },
+    { "SimImageSent", "image sent, packet {a} bytes, image {b} bytes" },
+    { "SimTextSent", "text message sent, packet {a} bytes" },
+    { "GcsTelemetryBatch", "telemetry backlog batch, {a} samples" },
+    { "GcsImageAck", "image {a} acknowledged at {b} of {c} bytes" },
+    { "SimReconnectScheduled", "reconnect attempt {a} in {b} ms" },
+    { "SimBacklogFlushed", "flushed {a} buffered samples in {b} frames" },
+    { "SimImageResumed", "image {a} resumed at {b} of {c} bytes" },
+    { "SimRateDecision", "image rate level {a}: quality {b}, interval {c} ms" },
+    { "GcsCodedImageDecodeFailed", "image decode failed, {a} bytes, codec {b}, head {c:x}" },
+    { "SimCodedImageSent", "image sent, {a} bytes, codec {b}" },
+    { "SimImageReencoded", "image {a} not offered as codec {b}, resent as {c} bytes of JPEG" },
+};
+
+quint64 steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Single-producer (owning thread) / single-consumer (drain thread) ring.
+struct Ring {
+    static const quint32 CAPACITY = 4096;
+    Record records[CAPACITY];
+    std::atomic<quint32> head{0};
+    std::atomic<quint32> tail{0};
+    std::atomic<bool> retired{false};
+    quint16 thread = 0;
+};
+
+struct RingHolder {
+    std::shared_ptr<Ring> ring;
+    ~RingHolder()
+    {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+std::mutex g_ringsMutex;
+std::vector<std::shared_ptr<Ring>> g_rings;
+quint16 g_nextThread = 0;
+
+std::atomic<bool> g_running{false};
+std::atomic<quint32> g_sampleInterval{64};
+std::atomic<quint64> g_dropped{0};
+FileHeader g_header;
+QFile g_file;
+QThread* g_drainThread = nullptr;
+
+Ring* localRing()
+{
+    thread_local RingHolder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        holder.ring->thread = g_nextThread++;
+        g_rings.push_back(holder.ring);
+    }
+    return holder.ring.get();
+}
+
+QString formatWith(const Record& record, const FileHeader& header)
+{
+    qint64 wallMs = header.wallClockMs + qint64(record.timestampNs - header.steadyNs) / 1000000;
+    QString time = QDateTime::fromMSecsSinceEpoch(wallMs).toString("hh:mm:ss.zzz");
+    if (record.event >= EventCount) {
+        return QString("%1 [T%2] unknown event %3").arg(time).arg(record.thread).arg(record.event);
+    }
+
+    const EventInfo& info = EVENTS[record.event];
+    const quint64 args[3] = { record.a, record.b, record.c };
+    QString text;
+    for (const char* p = info.format; *p; ++p) {
+        if (*p != '{' || p[1] < 'a' || p[1] > 'c') {
+            text += QLatin1Char(*p);
+            continue;
+        }
+        quint64 value = args[p[1] - 'a'];
+        char kind = p[2] == ':' ? p[3] : 'u';
+        if (kind == 'x') {
+            text += QString("%1").arg(value, 16, 16, QLatin1Char('0'));
+        } else if (kind == 'f') {
+            quint32 bits = quint32(value);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            text += QString::number(f, 'f', 6);
+        } else {
+            text += QString::number(value);
+        }
+        while (*p && *p != '}') {
+            ++p;
+        }
+        if (!*p) {
+            break;
+        }
+    }
+    return QString("%1 [T%2] %3: %4").arg(time).arg(record.thread).arg(info.name, text);
+}
+
+void drainOnce()
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        rings = g_rings;
+    }
+
+    std::vector<Record> batch;
+    for (const auto& ring : rings) {
+        quint32 tail = ring->tail.load(std::memory_order_relaxed);
+        quint32 head = ring->head.load(std::memory_order_acquire);
+        for (quint32 i = tail; i != head; ++i) {
+            batch.push_back(ring->records[i % Ring::CAPACITY]);
+        }
+        ring->tail.store(head, std::memory_order_release);
+    }
+
+    {
+        // Rings of finished threads are released once they are empty.
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        g_rings.erase(std::remove_if(g_rings.begin(), g_rings.end(), [](const std::shared_ptr<Ring>& ring) {
+            return ring->retired.load(std::memory_order_acquire)
+                && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+        }), g_rings.end());
+    }
+
+    if (batch.empty()) {
+        return;
+    }
+    std::sort(batch.begin(), batch.end(), [](const Record& l, const Record& r) {
+        return l.timestampNs < r.timestampNs;
+    });
+
+    if (g_file.isOpen()) {
+        g_file.write(reinterpret_cast<const char*>(batch.data()), qint64(batch.size() * sizeof(Record)));
+        g_file.flush();
+    } else {
+        for (const Record& record : batch) {
+            qDebug().noquote() << formatWith(record, g_header);
+        }
+    }
+}
+
+}
+
+void start(const QString& path)
+{
+    if (g_running.load()) {
+        return;
+    }
+
+    g_header.magic = FILE_MAGIC;
+    g_header.version = FILE_VERSION;
+    g_header.wallClockMs = QDateTime::currentMSecsSinceEpoch();
+    g_header.steadyNs = steadyNow();
+
+    if (!path.isEmpty()) {
+        g_file.setFileName(path);
+        if (g_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            g_file.write(reinterpret_cast<const char*>(&g_header), sizeof(g_header));
+        } else {
+            qDebug() << "Could not open binary log" << path << ", logging to qDebug:" << g_file.errorString();
+        }
+    }
+
+    g_running.store(true);
+    g_drainThread = QThread::create([]() {
+        while (g_running.load(std::memory_order_relaxed)) {
+            drainOnce();
+            QThread::msleep(20);
+        }
+        drainOnce();
+    });
+    g_drainThread->setObjectName("BinaryLog");
+    g_drainThread->start(QThread::LowPriority);
+}
+
+void stop()
+{
+    if (!g_running.exchange(false)) {
+        return;
+    }
+    g_drainThread->wait();
+    delete g_drainThread;
+    g_drainThread = nullptr;
+    g_file.close();
+}
+
+void record(Event event, quint32 a, quint64 b, quint64 c)
+{
+    if (!g_running.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    Ring* ring = localRing();
+    quint32 head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= Ring::CAPACITY) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& slot = ring->records[head % Ring::CAPACITY];
+    slot.timestampNs = steadyNow();
+    slot.event = event;
+    slot.thread = ring->thread;
+    slot.a = a;
+    slot.b = b;
+    slot.c = c;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void setSampleInterval(quint32 interval)
+{
+    g_sampleInterval.store(qMax<quint32>(1, interval), std::memory_order_relaxed);
+}
+
+quint32 sampleInterval()
+{
+    return g_sampleInterval.load(std::memory_order_relaxed);
+}
+
+quint64 droppedRecords()
+{
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+QString format(const Record& record)
+{
+    return formatWith(record, g_header);
+}
+
+bool decodeFile(const QString& path, QTextStream& out)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        out << "Cannot open " << path << ": " << file.errorString() << "\n";
+        return false;
+    }
+
+    FileHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+        out << path << " is not a binary log\n";
+        return false;
+    }
+
+    Record record;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record)) == sizeof(record)) {
+        out << formatWith(record, header) << "\n";
+    }
+    return true;
+}
+
+}
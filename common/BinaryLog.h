@@ -0,0 +1,132 @@
+#ifndef BINARYLOG_H
+#define BINARYLOG_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+#include <QTextStream>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+// Low-overhead event log for the packet paths.
+//
+// Call sites record a fixed-size binary Record (event id + up to three
+// integer arguments) into a lock-free ring owned by the calling thread. A
+// background thread drains the rings and either appends the raw records to a
+// log file (decoded later with BinaryLog::decodeFile) or formats them to
+// qDebug. No string formatting happens on the recording thread.
+//
+// Levels below BLOG_MIN_LEVEL are discarded at compile time: the arguments of
+// a disabled BLOG_* macro are never evaluated.
+namespace BinaryLog {
+
+enum Level : quint8 {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warning = 3
+};
+
+// Event ids are stored in log files, append new ones at the end.
+enum Event : quint16 {
+    GcsBufferReceived = 0,
+    GcsTelemetryParsed,
+    GcsImageChunk,
+    GcsImageWaiting,
+    GcsImageDecoded,
+    GcsImageDecodeFailed,       // before image codecs; see GcsCodedImageDecodeFailed
+    SimSendBytes,
+    SimSendText,
+    SimImageSent,               // before image codecs; see SimCodedImageSent
+    SimTextSent,
+    GcsTelemetryBatch,
+    GcsImageAck,
+    SimReconnectScheduled,
+    SimBacklogFlushed,
+    SimImageResumed,
+    SimRateDecision,
+    GcsCodedImageDecodeFailed,
+    SimCodedImageSent,
+    SimImageReencoded,
+    EventCount
+};
+
+struct Record {
+    quint64 timestampNs;
+    quint16 event;
+    quint16 thread;
+    quint32 a;
+    quint64 b;
+    quint64 c;
+};
+static_assert(sizeof(Record) == 32, "BinaryLog::Record must stay 32 bytes");
+
+// Starts the drain thread. With an empty path records are formatted to qDebug,
+// otherwise they are appended in binary form to the given file.
+void start(const QString& path = QString());
+void stop();
+
+void record(Event event, quint32 a = 0, quint64 b = 0, quint64 c = 0);
+
+// Every sampleInterval()-th hit of a BLOG_SAMPLED call site is recorded.
+void setSampleInterval(quint32 interval);
+quint32 sampleInterval();
+
+quint64 droppedRecords();
+
+QString format(const Record& record);
+bool decodeFile(const QString& path, QTextStream& out);
+
+// First (up to) eight bytes of a packet packed big-endian, for hex dumps.
+inline quint64 prefix(const QByteArray& data)
+{
+    quint64 value = 0;
+    int n = qMin<int>(8, data.size());
+    for (int i = 0; i < n; ++i) {
+        value = (value << 8) | quint8(data[i]);
+    }
+    return value << (8 * (8 - n));
+}
+
+inline quint64 floatBits(float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+}
+
+#ifndef BLOG_MIN_LEVEL
+#  ifdef QT_NO_DEBUG
+#    define BLOG_MIN_LEVEL BinaryLog::Info
+#  else
+#    define BLOG_MIN_LEVEL BinaryLog::Debug
+#  endif
+#endif
+
+#define BLOG(level, ...) \
+    do { \
+        if constexpr ((level) >= BLOG_MIN_LEVEL) { \
+            BinaryLog::record(__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define BLOG_SAMPLED(level, ...) \
+    do { \
+        if constexpr ((level) >= BLOG_MIN_LEVEL) { \
+            static thread_local quint32 blogSampleCounter = 0; \
+            if (++blogSampleCounter >= BinaryLog::sampleInterval()) { \
+                blogSampleCounter = 0; \
+                BinaryLog::record(__VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#define BLOG_TRACE(...) BLOG(BinaryLog::Trace, __VA_ARGS__)
+#define BLOG_DEBUG(...) BLOG(BinaryLog::Debug, __VA_ARGS__)
+#define BLOG_INFO(...) BLOG(BinaryLog::Info, __VA_ARGS__)
+#define BLOG_WARN(...) BLOG(BinaryLog::Warning, __VA_ARGS__)
+
+#endif // BINARYLOG_H
@@ -0,0 +1,70 @@
+#include "DiagnosticsPanel.h"
+#include "Metrics.h"
+
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+DiagnosticsPanel::DiagnosticsPanel(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle("Diagnostics");
+    resize(900, 600);
+
+    _table = new QTableWidget(0, 4, this);
+    _table->setHorizontalHeaderLabels({ "Metric", "Labels", "Value", "Rate/s" });
+    _table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    _table->horizontalHeader()->setStretchLastSection(true);
+    _table->verticalHeader()->setVisible(false);
+    _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    auto layout = new QVBoxLayout(this);
+    layout->addWidget(_table);
+
+    connect(&_timer, &QTimer::timeout, this, &DiagnosticsPanel::refresh);
+}
+
+void DiagnosticsPanel::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+    refresh();
+    _timer.start(1000);
+}
+
+void DiagnosticsPanel::hideEvent(QHideEvent* event)
+{
+    QDialog::hideEvent(event);
+    _timer.stop();
+}
+
+void DiagnosticsPanel::refresh()
+{
+    QVector<MetricSample> samples = MetricsRegistry::instance().collect();
+    double seconds = _sinceRefresh.isValid() ? _sinceRefresh.restart() / 1000.0 : 0.0;
+    if (!_sinceRefresh.isValid()) {
+        _sinceRefresh.start();
+    }
+
+    QHash<QString, double> current;
+    _table->setRowCount(samples.size());
+    for (int row = 0; row < samples.size(); ++row) {
+        const MetricSample& sample = samples[row];
+        QString key = sample.name + "{" + sample.labels + "}";
+        current.insert(key, sample.value);
+
+        QString rate;
+        if (sample.type != "gauge" && seconds > 0 && _previous.contains(key)) {
+            rate = QString::number((sample.value - _previous.value(key)) / seconds, 'f', 1);
+        }
+
+        const QString cells[] = { sample.name, sample.labels, QString::number(sample.value, 'g', 12), rate };
+        for (int column = 0; column < 4; ++column) {
+            QTableWidgetItem* item = _table->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem;
+                _table->setItem(row, column, item);
+            }
+            item->setText(cells[column]);
+        }
+    }
+    _previous = current;
+}
@@ -0,0 +1,33 @@
+#ifndef DIAGNOSTICSPANEL_H
+#define DIAGNOSTICSPANEL_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QTimer>
+#include <QHash>
+#include <QElapsedTimer>
+
+// Table view of the MetricsRegistry, refreshed once per second while shown.
+// Counters also get a per-second rate computed from the previous refresh.
+class DiagnosticsPanel : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsPanel(QWidget *parent = nullptr);
+
+protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+private slots:
+    void refresh();
+
+private:
+    QTableWidget* _table;
+    QTimer _timer;
+    QHash<QString, double> _previous;
+    QElapsedTimer _sinceRefresh;
+};
+
+#endif // DIAGNOSTICSPANEL_H
@@ -0,0 +1,367 @@
+#include "ImageCodec.h"
+
+#include <QBuffer>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// Decoders allocate the image before reading the pixels; nothing larger is
+// ever sent, and a corrupt or hostile header cannot ask for gigabytes.
+const quint32 MAX_IMAGE_SIDE = 8192;
+
+// QOI, following the reference specification (qoiformat.org) so that the
+// payloads are ordinary .qoi files.
+const quint8 QOI_OP_INDEX = 0x00;
+const quint8 QOI_OP_DIFF = 0x40;
+const quint8 QOI_OP_LUMA = 0x80;
+const quint8 QOI_OP_RUN = 0xc0;
+const quint8 QOI_OP_RGB = 0xfe;
+const quint8 QOI_OP_RGBA = 0xff;
+const quint8 QOI_MASK_2 = 0xc0;
+const int QOI_HEADER_SIZE = 14;
+const quint8 QOI_PADDING[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+const int QOI_MAX_RUN = 62;              // pixels per QOI_OP_RUN byte
+
+struct QoiPixel {
+    quint8 r, g, b, a;
+    bool operator==(const QoiPixel& other) const
+    {
+        return r == other.r && g == other.g && b == other.b && a == other.a;
+    }
+};
+
+inline int qoiHash(const QoiPixel& p)
+{
+    return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+}
+
+// Encodes rows of 3 (RGB) or 4 (RGBA) byte pixels. `out` must hold
+// qoiMaxSize() bytes; returns the number of bytes written.
+qsizetype qoiEncode(const uchar* pixels, int width, int height, qsizetype stride, int channels, uchar* out)
+{
+    uchar* p = out;
+    const char magic[4] = { 'q', 'o', 'i', 'f' };
+    std::memcpy(p, magic, 4);
+    qToBigEndian(quint32(width), p + 4);
+    qToBigEndian(quint32(height), p + 8);
+    p[12] = uchar(channels);
+    p[13] = 0; // sRGB with linear alpha
+    p += QOI_HEADER_SIZE;
+
+    QoiPixel index[64];
+    std::memset(index, 0, sizeof(index));
+    QoiPixel prev = { 0, 0, 0, 255 };
+    QoiPixel px = prev;
+    int run = 0;
+    const qint64 total = qint64(width) * height;
+    qint64 n = 0;
+
+    for (int y = 0; y < height; ++y) {
+        const uchar* row = pixels + y * stride;
+        for (int x = 0; x < width; ++x, ++n) {
+            const uchar* s = row + x * channels;
+            px.r = s[0];
+            px.g = s[1];
+            px.b = s[2];
+            if (channels == 4) {
+                px.a = s[3];
+            }
+
+            if (px == prev) {
+                ++run;
+                if (run == QOI_MAX_RUN || n == total - 1) {
+                    *p++ = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                *p++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            int hash = qoiHash(px);
+            if (index[hash] == px) {
+                *p++ = QOI_OP_INDEX | hash;
+            } else {
+                index[hash] = px;
+                if (px.a == prev.a) {
+                    qint8 vr = qint8(px.r - prev.r);
+                    qint8 vg = qint8(px.g - prev.g);
+                    qint8 vb = qint8(px.b - prev.b);
+                    qint8 vgr = qint8(vr - vg);
+                    qint8 vgb = qint8(vb - vg);
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        *p++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                    } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                        *p++ = QOI_OP_LUMA | (vg + 32);
+                        *p++ = (vgr + 8) << 4 | (vgb + 8);
+                    } else {
+                        *p++ = QOI_OP_RGB;
+                        *p++ = px.r;
+                        *p++ = px.g;
+                        *p++ = px.b;
+                    }
+                } else {
+                    *p++ = QOI_OP_RGBA;
+                    *p++ = px.r;
+                    *p++ = px.g;
+                    *p++ = px.b;
+                    *p++ = px.a;
+                }
+            }
+            prev = px;
+        }
+    }
+
+    std::memcpy(p, QOI_PADDING, sizeof(QOI_PADDING));
+    p += sizeof(QOI_PADDING);
+    return p - out;
+}
+
+qsizetype qoiMaxSize(int width, int height, int channels)
+{
+    return QOI_HEADER_SIZE + qsizetype(width) * height * (channels + 1) + qsizetype(sizeof(QOI_PADDING));
+}
+
+bool qoiReadHeader(const uchar* data, qsizetype size, int& width, int& height, int& channels)
+{
+    if (size < QOI_HEADER_SIZE + qsizetype(sizeof(QOI_PADDING)) || std::memcmp(data, "qoif", 4) != 0) {
+        return false;
+    }
+    quint32 w = qFromBigEndian<quint32>(data + 4);
+    quint32 h = qFromBigEndian<quint32>(data + 8);
+    channels = data[12];
+    if (w == 0 || h == 0 || w > MAX_IMAGE_SIDE || h > MAX_IMAGE_SIDE || (channels != 3 && channels != 4)) {
+        return false;
+    }
+    // Every byte between the header and the end marker yields at most one
+    // run of pixels; a header claiming more cannot be filled.
+    quint64 payload = quint64(size) - QOI_HEADER_SIZE - sizeof(QOI_PADDING);
+    if (quint64(w) * h > payload * QOI_MAX_RUN) {
+        return false;
+    }
+    width = int(w);
+    height = int(h);
+    return true;
+}
+
+// Decodes into rows of `channels` byte pixels; the header must have been
+// validated with qoiReadHeader. Returns false on truncated input.
+bool qoiDecode(const uchar* data, qsizetype size, uchar* pixels, qsizetype stride, int width, int height, int channels)
+{
+    QoiPixel index[64];
+    std::memset(index, 0, sizeof(index));
+    QoiPixel px = { 0, 0, 0, 255 };
+    int run = 0;
+    qsizetype pos = QOI_HEADER_SIZE;
+    const qsizetype end = size - qsizetype(sizeof(QOI_PADDING));
+
+    for (int y = 0; y < height; ++y) {
+        uchar* row = pixels + y * stride;
+        for (int x = 0; x < width; ++x) {
+            if (run > 0) {
+                --run;
+            } else {
+                if (pos >= end) {
+                    return false;
+                }
+                quint8 b1 = data[pos++];
+                if (b1 == QOI_OP_RGB) {
+                    if (pos + 3 > end) return false;
+                    px.r = data[pos++];
+                    px.g = data[pos++];
+                    px.b = data[pos++];
+                } else if (b1 == QOI_OP_RGBA) {
+                    if (pos + 4 > end) return false;
+                    px.r = data[pos++];
+                    px.g = data[pos++];
+                    px.b = data[pos++];
+                    px.a = data[pos++];
+                } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                    px = index[b1];
+                } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                    px.r += ((b1 >> 4) & 0x03) - 2;
+                    px.g += ((b1 >> 2) & 0x03) - 2;
+                    px.b += (b1 & 0x03) - 2;
+                } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                    if (pos + 1 > end) return false;
+                    quint8 b2 = data[pos++];
+                    int vg = (b1 & 0x3f) - 32;
+                    px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                    px.g += vg;
+                    px.b += vg - 8 + (b2 & 0x0f);
+                } else {
+                    run = b1 & 0x3f;
+                }
+                index[qoiHash(px)] = px;
+            }
+
+            uchar* d = row + x * channels;
+            d[0] = px.r;
+            d[1] = px.g;
+            d[2] = px.b;
+            if (channels == 4) {
+                d[3] = px.a;
+            }
+        }
+    }
+    return true;
+}
+
+const int RAW_HEADER_SIZE = 8;
+
+bool readRawHeader(const QByteArray& data, int bytesPerPixel, int& width, int& height)
+{
+    if (data.size() < RAW_HEADER_SIZE) {
+        return false;
+    }
+    quint32 w = qFromBigEndian<quint32>(data.constData());
+    quint32 h = qFromBigEndian<quint32>(data.constData() + 4);
+    if (w == 0 || h == 0 || w > MAX_IMAGE_SIDE || h > MAX_IMAGE_SIDE
+        || quint64(w) * h * bytesPerPixel != quint64(data.size() - RAW_HEADER_SIZE)) {
+        return false;
+    }
+    width = int(w);
+    height = int(h);
+    return true;
+}
+
+QByteArray encodeRaw(const QImage& source, QImage::Format format, int bytesPerPixel)
+{
+    QImage image = source.convertToFormat(format);
+    const qsizetype rowBytes = qsizetype(image.width()) * bytesPerPixel;
+    QByteArray data(RAW_HEADER_SIZE + rowBytes * image.height(), Qt::Uninitialized);
+    char* p = data.data();
+    qToBigEndian(quint32(image.width()), p);
+    qToBigEndian(quint32(image.height()), p + 4);
+    p += RAW_HEADER_SIZE;
+    for (int y = 0; y < image.height(); ++y, p += rowBytes) {
+        if (format == QImage::Format_RGB16) {
+            // QImage keeps RGB16 in host order; the wire format is little-endian.
+            qToLittleEndian<quint16>(image.constScanLine(y), image.width(), p);
+        } else {
+            std::memcpy(p, image.constScanLine(y), rowBytes);
+        }
+    }
+    return data;
+}
+
+QImage decodeRaw(const QByteArray& data, QImage::Format format, int bytesPerPixel)
+{
+    int width, height;
+    if (!readRawHeader(data, bytesPerPixel, width, height)) {
+        return QImage();
+    }
+    QImage image(width, height, format);
+    if (image.isNull()) {
+        return QImage();
+    }
+    const qsizetype rowBytes = qsizetype(width) * bytesPerPixel;
+    const char* p = data.constData() + RAW_HEADER_SIZE;
+    for (int y = 0; y < height; ++y, p += rowBytes) {
+        if (format == QImage::Format_RGB16) {
+            qFromLittleEndian<quint16>(p, width, image.scanLine(y));
+        } else {
+            std::memcpy(image.scanLine(y), p, rowBytes);
+        }
+    }
+    return image;
+}
+
+}
+
+namespace ImageCodecs {
+
+quint32 supportedMask()
+{
+    return mask(ImageCodec::Jpeg) | mask(ImageCodec::Qoi) | mask(ImageCodec::Raw) | mask(ImageCodec::Rgb565);
+}
+
+QString name(ImageCodec codec)
+{
+    switch (codec) {
+    case ImageCodec::Jpeg: return "jpeg";
+    case ImageCodec::Qoi: return "qoi";
+    case ImageCodec::Raw: return "raw";
+    case ImageCodec::Rgb565: return "rgb565";
+    default: return "unknown";
+    }
+}
+
+bool fromName(const QString& name, ImageCodec& codec)
+{
+    for (int i = 0; i < int(ImageCodec::Count); ++i) {
+        if (name.compare(ImageCodecs::name(ImageCodec(i)), Qt::CaseInsensitive) == 0) {
+            codec = ImageCodec(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+QString fileSuffix(ImageCodec codec)
+{
+    return codec == ImageCodec::Jpeg ? "jpg" : name(codec);
+}
+
+QByteArray encode(const QImage& image, ImageCodec codec, int quality)
+{
+    switch (codec) {
+    case ImageCodec::Jpeg: {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "JPEG", quality);
+        return data;
+    }
+    case ImageCodec::Qoi: {
+        int channels = image.hasAlphaChannel() ? 4 : 3;
+        QImage pixels = image.convertToFormat(channels == 4 ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+        QByteArray data(qoiMaxSize(pixels.width(), pixels.height(), channels), Qt::Uninitialized);
+        qsizetype size = qoiEncode(pixels.constBits(), pixels.width(), pixels.height(), pixels.bytesPerLine(),
+                                   channels, reinterpret_cast<uchar*>(data.data()));
+        data.resize(size);
+        return data;
+    }
+    case ImageCodec::Raw:
+        return encodeRaw(image, QImage::Format_RGB888, 3);
+    case ImageCodec::Rgb565:
+        return encodeRaw(image, QImage::Format_RGB16, 2);
+    default:
+        return QByteArray();
+    }
+}
+
+QImage decode(const QByteArray& data, ImageCodec codec)
+{
+    switch (codec) {
+    case ImageCodec::Jpeg: {
+        QImage image;
+        image.loadFromData(data, "JPG");
+        return image;
+    }
+    case ImageCodec::Qoi: {
+        const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+        int width, height, channels;
+        if (!qoiReadHeader(bytes, data.size(), width, height, channels)) {
+            return QImage();
+        }
+        QImage image(width, height, channels == 4 ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+        if (image.isNull() || !qoiDecode(bytes, data.size(), image.bits(), image.bytesPerLine(), width, height, channels)) {
+            return QImage();
+        }
+        return image;
+    }
+    case ImageCodec::Raw:
+        return decodeRaw(data, QImage::Format_RGB888, 3);
+    case ImageCodec::Rgb565:
+        return decodeRaw(data, QImage::Format_RGB16, 2);
+    default:
+        return QImage();
+    }
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef IMAGECODEC_H
+#define IMAGECODEC_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+// Image payload encodings. The codec id travels in every IMAGE_CHUNK frame
+// and the GCS advertises the ids it can decode in a CODEC_OFFER frame.
+//
+//   Jpeg    lossy, smallest on constrained links; quality is 1-100
+//   Qoi     "Quite OK Image" format, lossless and much faster than JPEG or PNG
+//   Raw     uncompressed RGB888: quint32 width, quint32 height, rows
+//   Rgb565  uncompressed 16 bit: quint32 width, quint32 height, little-endian
+//           RGB565 pixels; lossy in colour depth only
+enum class ImageCodec : quint8 {
+    Jpeg = 0,
+    Qoi = 1,
+    Raw = 2,
+    Rgb565 = 3,
+    Count
+};
+
+namespace ImageCodecs {
+
+inline quint32 mask(ImageCodec codec)
+{
+    return 1u << quint8(codec);
+}
+
+quint32 supportedMask();
+QString name(ImageCodec codec);
+bool fromName(const QString& name, ImageCodec& codec);
+QString fileSuffix(ImageCodec codec);
+
+QByteArray encode(const QImage& image, ImageCodec codec, int quality = -1);
+QImage decode(const QByteArray& data, ImageCodec codec);
+
+}
+
+#endif // IMAGECODEC_H
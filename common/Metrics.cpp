@@ -0,0 +1,129 @@
+#include "Metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+QString escapeLabel(QString value)
+{
+    return value.replace(QLatin1Char('\\'), QLatin1String("\\\\"))
+        .replace(QLatin1Char('"'), QLatin1String("\\\""))
+        .replace(QLatin1Char('\n'), QLatin1String("\\n"));
+}
+
+}
+
+void Timing::record(qint64 ns)
+{
+    quint64 value = quint64(qMax<qint64>(0, ns));
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _totalNs.fetch_add(value, std::memory_order_relaxed);
+    quint64 max = _maxNs.load(std::memory_order_relaxed);
+    while (value > max && !_maxNs.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void MetricsRegistry::setApplication(const QString& application)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _application = application;
+}
+
+std::shared_ptr<ConnectionMetrics> MetricsRegistry::addConnection(const QString& peer)
+{
+    auto connection = std::make_shared<ConnectionMetrics>(peer);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _connections.push_back(connection);
+    return connection;
+}
+
+void MetricsRegistry::removeConnection(const std::shared_ptr<ConnectionMetrics>& connection)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _connections.erase(std::remove(_connections.begin(), _connections.end(), connection), _connections.end());
+}
+
+Gauge& MetricsRegistry::gauge(const QString& name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::unique_ptr<Gauge>& gauge = _gauges[name];
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+const char* MetricsRegistry::stageName(Stage stage)
+{
+    switch (stage) {
+    case Stage::TelemetryParse: return "telemetry_parse";
+    case Stage::ImageDecode: return "image_decode";
+    case Stage::ImageEncode: return "image_encode";
+    case Stage::ImageArchive: return "image_archive";
+    default: return "unknown";
+    }
+}
+
+QVector<MetricSample> MetricsRegistry::collect() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    QVector<MetricSample> samples;
+    QString app = QString("app=\"%1\"").arg(escapeLabel(_application));
+
+    // Samples of one metric must be adjacent in the exposition format, so the
+    // loops run per metric rather than per connection or stage.
+    auto addConnectionMetric = [&](const char* name, const char* type, auto value) {
+        for (const auto& connection : _connections) {
+            QString labels = QString("%1,peer=\"%2\"").arg(app, escapeLabel(connection->peer));
+            samples.append({ name, type, labels, double(value(*connection)) });
+        }
+    };
+    addConnectionMetric("uav_connection_bytes_in_total", "counter", [](const ConnectionMetrics& c) { return c.bytesIn.value(); });
+    addConnectionMetric("uav_connection_bytes_out_total", "counter", [](const ConnectionMetrics& c) { return c.bytesOut.value(); });
+    addConnectionMetric("uav_connection_frames_in_total", "counter", [](const ConnectionMetrics& c) { return c.framesIn.value(); });
+    addConnectionMetric("uav_connection_frames_out_total", "counter", [](const ConnectionMetrics& c) { return c.framesOut.value(); });
+    addConnectionMetric("uav_connection_drops_total", "counter", [](const ConnectionMetrics& c) { return c.drops.value(); });
+    addConnectionMetric("uav_connection_buffered_bytes", "gauge", [](const ConnectionMetrics& c) { return c.bufferedBytes.value(); });
+
+    auto addStageMetric = [&](const char* name, const char* type, auto value, const char* family = "") {
+        for (int i = 0; i < int(Stage::Count); ++i) {
+            QString labels = QString("%1,stage=\"%2\"").arg(app, stageName(Stage(i)));
+            samples.append({ name, type, labels, double(value(_stages[i])), family });
+        }
+    };
+    addStageMetric("uav_stage_duration_seconds_sum", "summary", [](const StageMetrics& s) { return s.duration.totalNs() / 1e9; },
+                   "uav_stage_duration_seconds");
+    addStageMetric("uav_stage_duration_seconds_count", "summary", [](const StageMetrics& s) { return s.duration.count(); },
+                   "uav_stage_duration_seconds");
+    addStageMetric("uav_stage_duration_max_seconds", "gauge", [](const StageMetrics& s) { return s.duration.maxNs() / 1e9; });
+    addStageMetric("uav_stage_queue_depth", "gauge", [](const StageMetrics& s) { return s.queueDepth.value(); });
+    addStageMetric("uav_stage_drops_total", "counter", [](const StageMetrics& s) { return s.drops.value(); });
+
+    samples.append({ "uav_connections_accepted_total", "counter", app, double(_connectionsAccepted.value()) });
+    samples.append({ "uav_reconnects_total", "counter", app, double(_reconnects.value()) });
+    for (const auto& gauge : _gauges) {
+        samples.append({ "uav_" + gauge.first, "gauge", app, double(gauge.second->value()) });
+    }
+    return samples;
+}
+
+QByteArray MetricsRegistry::prometheusText() const
+{
+    QByteArray text;
+    QString lastFamily;
+    for (const MetricSample& sample : collect()) {
+        QString family = sample.family.isEmpty() ? sample.name : sample.family;
+        if (family != lastFamily) {
+            text += QString("# TYPE %1 %2\n").arg(family, sample.type).toUtf8();
+            lastFamily = family;
+        }
+        text += QString("%1{%2} %3\n").arg(sample.name, sample.labels).arg(sample.value, 0, 'g', 15).toUtf8();
+    }
+    return text;
+}
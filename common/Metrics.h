@@ -0,0 +1,135 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Counters and gauges updated from the packet paths. Updates are relaxed
+// atomics; the registry mutex is only taken when connections come and go and
+// when a snapshot is collected.
+
+class Counter
+{
+public:
+    void add(quint64 n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> _value{0};
+};
+
+class Gauge
+{
+public:
+    void set(qint64 value) { _value.store(value, std::memory_order_relaxed); }
+    void add(qint64 n) { _value.fetch_add(n, std::memory_order_relaxed); }
+    qint64 value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> _value{0};
+};
+
+// Count, total and maximum of a duration. Exported as a Prometheus summary
+// without quantiles, plus a gauge for the maximum.
+class Timing
+{
+public:
+    void record(qint64 ns);
+    quint64 count() const { return _count.load(std::memory_order_relaxed); }
+    quint64 totalNs() const { return _totalNs.load(std::memory_order_relaxed); }
+    quint64 maxNs() const { return _maxNs.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> _count{0};
+    std::atomic<quint64> _totalNs{0};
+    std::atomic<quint64> _maxNs{0};
+};
+
+// Records the time between construction and destruction into a Timing.
+class ScopedTiming
+{
+public:
+    explicit ScopedTiming(Timing& timing) : _timing(timing) { _timer.start(); }
+    ~ScopedTiming() { _timing.record(_timer.nsecsElapsed()); }
+
+private:
+    Timing& _timing;
+    QElapsedTimer _timer;
+};
+
+struct ConnectionMetrics {
+    explicit ConnectionMetrics(const QString& peer) : peer(peer) {}
+
+    const QString peer;
+    Counter bytesIn;
+    Counter bytesOut;
+    Counter framesIn;
+    Counter framesOut;
+    Counter drops;
+    Gauge bufferedBytes; // received but not yet decoded, or queued to send
+};
+
+struct StageMetrics {
+    Timing duration;
+    Gauge queueDepth;
+    Counter drops;
+};
+
+enum class Stage {
+    TelemetryParse,
+    ImageDecode,
+    ImageEncode,
+    ImageArchive,
+    Count
+};
+
+struct MetricSample {
+    QString name;
+    QString type;   // "counter", "gauge" or "summary"
+    QString labels; // already formatted, e.g. peer="127.0.0.1:5000"
+    double value;
+    QString family; // for the _sum and _count samples of a summary, its name
+};
+
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry& instance();
+
+    void setApplication(const QString& application);
+
+    std::shared_ptr<ConnectionMetrics> addConnection(const QString& peer);
+    void removeConnection(const std::shared_ptr<ConnectionMetrics>& connection);
+
+    StageMetrics& stage(Stage stage) { return _stages[int(stage)]; }
+    Counter& reconnects() { return _reconnects; }
+    Counter& connectionsAccepted() { return _connectionsAccepted; }
+
+    // Application-specific gauge exported as uav_<name>. The reference stays
+    // valid for the lifetime of the process; look it up once, not per update.
+    Gauge& gauge(const QString& name);
+
+    QVector<MetricSample> collect() const;
+    QByteArray prometheusText() const;
+
+    static const char* stageName(Stage stage);
+
+private:
+    MetricsRegistry() = default;
+
+    mutable std::mutex _mutex;
+    QString _application;
+    std::vector<std::shared_ptr<ConnectionMetrics>> _connections;
+    StageMetrics _stages[int(Stage::Count)];
+    Counter _reconnects;
+    Counter _connectionsAccepted;
+    std::map<QString, std::unique_ptr<Gauge>> _gauges;
+};
+
+#endif // METRICS_H
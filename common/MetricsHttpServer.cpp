@@ -0,0 +1,59 @@
+#include "MetricsHttpServer.h"
+#include "Metrics.h"
+
+#include <QDebug>
+
+MetricsHttpServer::MetricsHttpServer(quint16 port, QObject *parent)
+    : QObject(parent)
+{
+    _server = new QTcpServer(this);
+    connect(_server, &QTcpServer::newConnection, this, &MetricsHttpServer::on_client_connecting);
+    if (_server->listen(QHostAddress::LocalHost, port)) {
+        qDebug() << "Metrics endpoint at http://127.0.0.1:" << port << "/metrics";
+    } else {
+        qDebug() << "Metrics endpoint could not listen on port" << port << ":" << _server->errorString();
+    }
+}
+
+bool MetricsHttpServer::isListening() const
+{
+    return _server->isListening();
+}
+
+void MetricsHttpServer::on_client_connecting()
+{
+    while (auto socket = _server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, &MetricsHttpServer::clientDataReady);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void MetricsHttpServer::clientDataReady()
+{
+    auto socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) return;
+
+    // The request is left in the socket buffer until the header is complete.
+    QByteArray request = socket->peek(MAX_REQUEST_SIZE);
+    if (!request.contains("\r\n\r\n") && request.size() < MAX_REQUEST_SIZE) {
+        return;
+    }
+    disconnect(socket, &QTcpSocket::readyRead, this, &MetricsHttpServer::clientDataReady);
+
+    QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (requestLine.size() < 2 || requestLine[0] != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (requestLine[1] != "/metrics" && requestLine[1] != "/") {
+        status = "404 Not Found";
+    } else {
+        body = MetricsRegistry::instance().prometheusText();
+    }
+
+    socket->write("HTTP/1.0 " + status + "\r\n"
+                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Connection: close\r\n\r\n" + body);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,28 @@
+#ifndef METRICSHTTPSERVER_H
+#define METRICSHTTPSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// Minimal HTTP/1.0 endpoint on localhost that serves the MetricsRegistry in
+// the Prometheus text format on GET /metrics.
+class MetricsHttpServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsHttpServer(quint16 port, QObject *parent = nullptr);
+    bool isListening() const;
+
+private slots:
+    void on_client_connecting();
+    void clientDataReady();
+
+private:
+    QTcpServer* _server;
+
+    static const int MAX_REQUEST_SIZE = 8192;
+};
+
+#endif // METRICSHTTPSERVER_H
@@ -0,0 +1,134 @@
+#include "Protocol.h"
+
+#include <QStringList>
+
+namespace Protocol {
+
+QString formatTelemetry(const TelemetrySample& sample)
+{
+    return QString("Latitude: %1, Longitude: %2, Altitude: %3")
+        .arg(sample.latitude, 0, 'f', 6)
+        .arg(sample.longitude, 0, 'f', 6)
+        .arg(sample.altitude, 0, 'f', 2);
+}
+
+bool parseTelemetry(const QString& line, TelemetrySample& sample)
+{
+    QStringList parts = line.trimmed().split(", ");
+    if (parts.size() != 3) {
+        return false;
+    }
+    float values[3];
+    for (int i = 0; i < 3; ++i) {
+        QStringList field = parts[i].split(": ");
+        bool ok = false;
+        values[i] = field.size() == 2 ? field[1].toFloat(&ok) : 0;
+        if (!ok) {
+            return false;
+        }
+    }
+    sample.latitude = values[0];
+    sample.longitude = values[1];
+    sample.altitude = values[2];
+    return true;
+}
+
+QByteArray encodeTextFrame(const QString& text)
+{
+    QByteArray utf8 = text.toUtf8();
+    QByteArray frame;
+    frame.reserve(8 + utf8.size());
+    appendU32(frame, TEXT_HEADER);
+    appendU32(frame, quint32(utf8.size()));
+    frame.append(utf8);
+    return frame;
+}
+
+QByteArray encodeTelemetryBatch(const TelemetrySample* samples, int count)
+{
+    QByteArray frame;
+    frame.reserve(6 + count * TELEMETRY_SAMPLE_SIZE);
+    appendU32(frame, TELEMETRY_BATCH_HEADER);
+    char countBytes[2];
+    qToBigEndian(quint16(count), countBytes);
+    frame.append(countBytes, 2);
+    for (int i = 0; i < count; ++i) {
+        char timestamp[8];
+        qToBigEndian(samples[i].timestamp, timestamp);
+        frame.append(timestamp, 8);
+        appendFloat(frame, samples[i].latitude);
+        appendFloat(frame, samples[i].longitude);
+        appendFloat(frame, samples[i].altitude);
+    }
+    return frame;
+}
+
+QByteArray encodeImageChunk(quint32 imageId, const QByteArray& image, quint32 offset, int size)
+{
+    QByteArray frame;
+    frame.reserve(IMAGE_CHUNK_FIXED_SIZE + size);
+    appendU32(frame, IMAGE_CHUNK_HEADER);
+    appendU32(frame, imageId);
+    appendU32(frame, quint32(image.size()));
+    appendU32(frame, offset);
+    appendU32(frame, quint32(size));
+    frame.append(image.constData() + offset, size);
+    return frame;
+}
+
+QByteArray encodeImageChunk(quint32 imageId, quint8 codec, const QByteArray& image, quint32 offset, int size)
+{
+    QByteArray frame;
+    frame.reserve(CODED_IMAGE_CHUNK_FIXED_SIZE + size);
+    appendU32(frame, CODED_IMAGE_CHUNK_HEADER);
+    appendU32(frame, imageId);
+    appendU32(frame, quint32(codec) << 24);
+    appendU32(frame, quint32(image.size()));
+    appendU32(frame, offset);
+    appendU32(frame, quint32(size));
+    frame.append(image.constData() + offset, size);
+    return frame;
+}
+
+QByteArray encodeCodecOffer(quint32 codecMask)
+{
+    QByteArray frame;
+    frame.reserve(CODEC_OFFER_SIZE);
+    appendU32(frame, CODEC_OFFER_HEADER);
+    appendU32(frame, codecMask);
+    return frame;
+}
+
+QByteArray encodeImageAck(quint32 imageId, quint32 receivedOffset)
+{
+    QByteArray frame;
+    frame.reserve(IMAGE_ACK_SIZE);
+    appendU32(frame, IMAGE_ACK_HEADER);
+    appendU32(frame, imageId);
+    appendU32(frame, receivedOffset);
+    return frame;
+}
+
+QByteArray encodeLinkFeedback(const LinkFeedback& feedback)
+{
+    QByteArray frame;
+    frame.reserve(LINK_FEEDBACK_SIZE);
+    appendU32(frame, LINK_FEEDBACK_HEADER);
+    appendU32(frame, feedback.rxBytesPerSecond);
+    appendU32(frame, feedback.decodeQueueDepth);
+    appendU32(frame, feedback.droppedImages);
+    appendU32(frame, feedback.decodeLatencyMs);
+    return frame;
+}
+
+LinkFeedback decodeLinkFeedback(const char* frame)
+{
+    LinkFeedback feedback;
+    feedback.rxBytesPerSecond = readU32(frame + 4);
+    feedback.decodeQueueDepth = readU32(frame + 8);
+    feedback.droppedImages = readU32(frame + 12);
+    feedback.decodeLatencyMs = readU32(frame + 16);
+    return feedback;
+}
+
+}
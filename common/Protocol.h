@@ -0,0 +1,111 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include <QtEndian>
+#include <cstring>
+
+// Wire format between the simulator and the GCS. All integers are big-endian
+// (the QDataStream default the original frames were written with); floats are
+// sent as their IEEE-754 bit pattern in a big-endian quint32.
+//
+// Simulator -> GCS
+//   "Latitude: <lat>, Longitude: <lon>, Altitude: <alt>\n"    live telemetry
+//   IMAGE_HEADER      qint32 size, <size> bytes of JPEG       whole image
+//   TEXT_HEADER       qint32 size, <size> bytes of UTF-8      operator message
+//   TELEMETRY_BATCH   quint16 count, count * TelemetrySample  outage backlog
+//   IMAGE_CHUNK       quint32 imageId, quint32 totalSize, quint32 offset,
+//                     qint32 size, <size> bytes               resumable JPEG
+//   CODED_IMAGE_CHUNK quint32 imageId, quint8 codec, 3 bytes reserved,
+//                     quint32 totalSize, quint32 offset, qint32 size,
+//                     <size> bytes                            any ImageCodec
+// GCS -> simulator, framed only
+//   TEXT_HEADER       qint32 size, <size> bytes of UTF-8      operator message
+//   CODEC_OFFER       quint32 mask of decodable ImageCodec ids, sent on connect
+//   IMAGE_ACK         quint32 imageId, quint32 receivedOffset
+//   LINK_FEEDBACK     quint32 rxBytesPerSecond, quint32 decodeQueueDepth,
+//                     quint32 droppedImages, quint32 decodeLatencyMs
+namespace Protocol {
+
+const quint32 IMAGE_HEADER = 0xA1B2C3D4;
+const quint32 TEXT_HEADER = 0xB1B2B3B4;
+const quint32 TELEMETRY_BATCH_HEADER = 0xC1C2C3C4;
+const quint32 IMAGE_CHUNK_HEADER = 0xA1B2C3D5;
+const quint32 IMAGE_ACK_HEADER = 0xA1B2C3D6;
+const quint32 LINK_FEEDBACK_HEADER = 0xA1B2C3D7;
+const quint32 CODEC_OFFER_HEADER = 0xA1B2C3D8;
+const quint32 CODED_IMAGE_CHUNK_HEADER = 0xA1B2C3D9;
+
+const int IMAGE_CHUNK_FIXED_SIZE = 20;       // header, id, total, offset, size
+const int CODED_IMAGE_CHUNK_FIXED_SIZE = 24; // plus codec and reserved bytes
+const int CODEC_OFFER_SIZE = 8;
+const int IMAGE_ACK_SIZE = 12;
+const int LINK_FEEDBACK_SIZE = 20;
+const int TELEMETRY_SAMPLE_SIZE = 20;        // qint64 + 3 * float
+const int MAX_BATCH_SAMPLES = 256;
+const qint32 MAX_FRAME_PAYLOAD = 64 * 1024 * 1024;
+
+struct TelemetrySample {
+    qint64 timestamp = 0; // msecs since epoch when the sample was taken
+    float latitude = 0;
+    float longitude = 0;
+    float altitude = 0;
+};
+
+// What the GCS reports about one vehicle, about once per second.
+struct LinkFeedback {
+    quint32 rxBytesPerSecond = 0;
+    quint32 decodeQueueDepth = 0;
+    quint32 droppedImages = 0;   // cumulative for the connection
+    quint32 decodeLatencyMs = 0; // mean queue + decode time over the last period
+};
+
+inline quint32 readU32(const char* p)
+{
+    return qFromBigEndian<quint32>(p);
+}
+
+inline float readFloat(const char* p)
+{
+    quint32 bits = readU32(p);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void appendU32(QByteArray& out, quint32 value)
+{
+    char bytes[4];
+    qToBigEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+inline void appendFloat(QByteArray& out, float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendU32(out, bits);
+}
+
+QString formatTelemetry(const TelemetrySample& sample);
+bool parseTelemetry(const QString& line, TelemetrySample& sample);
+
+QByteArray encodeTextFrame(const QString& text);
+QByteArray encodeTelemetryBatch(const TelemetrySample* samples, int count);
+QByteArray encodeImageChunk(quint32 imageId, const QByteArray& image, quint32 offset, int size);
+QByteArray encodeImageChunk(quint32 imageId, quint8 codec, const QByteArray& image, quint32 offset, int size);
+QByteArray encodeCodecOffer(quint32 codecMask);
+QByteArray encodeImageAck(quint32 imageId, quint32 receivedOffset);
+QByteArray encodeLinkFeedback(const LinkFeedback& feedback);
+LinkFeedback decodeLinkFeedback(const char* frame);
+
+}
+
+Q_DECLARE_METATYPE(Protocol::TelemetrySample)
+Q_DECLARE_METATYPE(Protocol::LinkFeedback)
+
+#endif // PROTOCOL_H
@@ -0,0 +1,20 @@
+# Code shared by the GCS and the simulator.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/BinaryLog.cpp \
+    $$PWD/DiagnosticsPanel.cpp \
+    $$PWD/ImageCodec.cpp \
+    $$PWD/Metrics.cpp \
+    $$PWD/MetricsHttpServer.cpp \
+    $$PWD/Protocol.cpp
+
+HEADERS += \
+    $$PWD/BinaryLog.h \
+    $$PWD/DiagnosticsPanel.h \
+    $$PWD/ImageCodec.h \
+    $$PWD/Metrics.h \
+    $$PWD/MetricsHttpServer.h \
+    $$PWD/Protocol.h